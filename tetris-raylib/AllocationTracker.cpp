@@ -0,0 +1,119 @@
+#include "AllocationTracker.h"
+#ifdef TRACK_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+namespace
+{
+	std::atomic<uint64_t> allocationCalls[AllocationCounts::tagCount];
+	std::atomic<uint64_t> allocationBytes[AllocationCounts::tagCount];
+	thread_local AllocationTag currentTag = AllocationTag::Other;
+
+	void* Allocate(std::size_t size) noexcept
+	{
+		const int tag = static_cast<int>(currentTag);
+		allocationCalls[tag].fetch_add(1, std::memory_order_relaxed);
+		allocationBytes[tag].fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size ? size : 1);
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	void* memory = Allocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+AllocationScope::AllocationScope(AllocationTag tag)
+	:
+	previousTag(currentTag)
+{
+	currentTag = tag;
+}
+
+AllocationScope::~AllocationScope() noexcept
+{
+	currentTag = previousTag;
+}
+#endif
+
+AllocationCounts GetAllocationCounts()
+{
+	AllocationCounts counts;
+#ifdef TRACK_ALLOCATIONS
+	for (int i = 0; i < AllocationCounts::tagCount; ++i)
+	{
+		counts.calls[i] = allocationCalls[i].load(std::memory_order_relaxed);
+		counts.bytes[i] = allocationBytes[i].load(std::memory_order_relaxed);
+	}
+#endif
+	return counts;
+}
+
+AllocationCounts operator-(const AllocationCounts& lhs, const AllocationCounts& rhs)
+{
+	AllocationCounts counts;
+	for (int i = 0; i < AllocationCounts::tagCount; ++i)
+	{
+		counts.calls[i] = lhs.calls[i] - rhs.calls[i];
+		counts.bytes[i] = lhs.bytes[i] - rhs.bytes[i];
+	}
+	return counts;
+}
+
+const char* GetAllocationTagName(AllocationTag tag)
+{
+	static constexpr const char* names[] = { "Other", "Render", "Simulation", "Session", "Recording" };
+	static_assert(sizeof(names) / sizeof(names[0]) == AllocationCounts::tagCount);
+	return names[static_cast<int>(tag)];
+}
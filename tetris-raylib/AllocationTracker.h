@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Debug instrumentation for heap allocations. Built with TRACK_ALLOCATIONS the global
+// operator new and delete are replaced and every allocation is counted against the
+// tag of the innermost AllocationScope on the calling thread. Without the flag the
+// scopes compile to nothing and the counts stay at zero.
+//
+// Only operator new is seen, allocations raylib or the C library make with malloc
+// are not counted.
+enum class AllocationTag
+{
+	Other,
+	Render,
+	Simulation,
+	Session,	// New games, replays, seeking and high scores, never on the per frame path
+	Recording,	// Replay index growth past the reserved capacity
+	Count
+};
+
+struct AllocationCounts
+{
+	static constexpr int tagCount = static_cast<int>(AllocationTag::Count);
+
+	std::array<uint64_t, tagCount> calls{};
+	std::array<uint64_t, tagCount> bytes{};
+
+	uint64_t GetCalls(AllocationTag tag) const
+	{
+		return calls[static_cast<int>(tag)];
+	}
+	uint64_t GetBytes(AllocationTag tag) const
+	{
+		return bytes[static_cast<int>(tag)];
+	}
+};
+
+// Totals since startup, subtract two of them to get the allocations in between
+AllocationCounts GetAllocationCounts();
+AllocationCounts operator-(const AllocationCounts& lhs, const AllocationCounts& rhs);
+const char* GetAllocationTagName(AllocationTag tag);
+
+class AllocationScope
+{
+public:
+#ifdef TRACK_ALLOCATIONS
+	explicit AllocationScope(AllocationTag tag);
+	~AllocationScope() noexcept;
+#else
+	explicit AllocationScope(AllocationTag) {}
+#endif
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+#ifdef TRACK_ALLOCATIONS
+private:
+	const AllocationTag previousTag;
+#endif
+};
\ No newline at end of file
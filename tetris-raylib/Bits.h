@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bit counting on row masks. C++17 has no <bit>, so these wrap the compiler intrinsics.
+// MSVC's __popcnt is always the POPCNT instruction and wasm has a native popcount, so
+// both shipped builds count in hardware. GCC and Clang on x86 need -mpopcnt for that,
+// without it __builtin_popcount is a library call.
+namespace bits
+{
+	inline int PopCount(uint32_t v)
+	{
+#ifdef _MSC_VER
+		return static_cast<int>(__popcnt(v));
+#else
+		return __builtin_popcount(v);
+#endif
+	}
+
+	// Index of the lowest set bit, v must not be zero
+	inline int CountTrailingZeros(uint32_t v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, v);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(v);
+#endif
+	}
+}
\ No newline at end of file
@@ -1,146 +1,290 @@
 #include "Board.h"
 #include <cassert>
+#include <algorithm>
+#include <cmath>
+#include "Settings.h"
+#include "Zobrist.h"
 
-Board::Cell::Cell() : bExists(false), c(WHITE)
+template<int W, int H>
+BasicBoard<W, H>::Cell::Cell() : c(WHITE)
 {
 }
 
-void Board::Cell::SetColor(Color c)
+template<int W, int H>
+void BasicBoard<W, H>::Cell::SetColor(Color c)
 {
 	this->c = c;
 }
 
-void Board::Cell::Add()
+template<int W, int H>
+Color BasicBoard<W, H>::Cell::GetColor() const
 {
-	bExists = true;
+	return c;
 }
 
-void Board::Cell::Remove()
+template<int W, int H>
+BasicBoard<W, H>::BasicBoard(Vec2<int> screenPos, Vec2<int> widthHeight, int cellSize, int padding)
+	: BoardSize<W, H>(widthHeight),
+	fullRowMask(static_cast<RowMask>(widthHeight.GetX() >= 32 ? ~0u : (1u << widthHeight.GetX()) - 1)),
+	cellSize(cellSize), screenPos(screenPos), padding(padding)
 {
-	bExists = false;
+	assert(GetWidth() > 0 && GetHeight() > 0);
+	assert(GetWidth() <= 32);	// Row occupancy has to fit in a 32 bit mask
+	assert(GetHeight() <= zobrist::maxRows);
+	assert(cellSize > 0);
+	if constexpr (isFixedSize) {
+		assert(widthHeight.GetX() == W && widthHeight.GetY() == H);
+	}
+	else {
+		cells.resize(GetWidth() * GetHeight());
+		rows.resize(GetHeight());
+	}
+	for (int y = 0; y < GetHeight(); ++y) {
+		rows[y].offset = y * GetWidth();
+	}
 }
 
-bool Board::Cell::Exists() const
+template<int W, int H>
+void BasicBoard<W, H>::SetRowMask(int y, uint32_t mask)
 {
-	return bExists;
+	Row& row = rows[RowIndex(y)];
+	hash ^= zobrist::RowKey(y, row.mask) ^ zobrist::RowKey(y, mask);
+	row.mask = static_cast<RowMask>(mask);
 }
 
-Color Board::Cell::GetColor() const
+template<int W, int H>
+const typename BasicBoard<W, H>::Cell& BasicBoard<W, H>::GetCell(Vec2<int> pos) const
 {
-	return c;
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
+	return cells[rows[RowIndex(pos.GetY())].offset + pos.GetX()];
 }
 
-Board::Board(Vec2<int> screenPos, Vec2<int> widthHeight, int cellSize, int padding)
-	: screenPos(screenPos), width(widthHeight.GetX()), height(widthHeight.GetY()), cellSize(cellSize), padding(padding)
+template<int W, int H>
+typename BasicBoard<W, H>::Cell& BasicBoard<W, H>::GetCell(Vec2<int> pos)
 {
-	assert(width > 0 && height > 0);
-	assert(cellSize > 0);
-	cells.resize(width * height);
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
+	return cells[rows[RowIndex(pos.GetY())].offset + pos.GetX()];
 }
 
-bool Board::IsTopRowOccupied() const {
-	for (int x = 0; x < width; ++x) {
-		if (CellExists(Vec2<int>(x, 0))) {
-			return true;
-		}
-	}
-	return false;
+template<int W, int H>
+bool BasicBoard<W, H>::IsTopRowOccupied() const {
+	return rows[RowIndex(0)].mask != 0;
 }
 
-void Board::DrawCell(Vec2<int> pos) const
+template<int W, int H>
+void BasicBoard<W, H>::DrawCell(Vec2<int> pos) const
 {
-	const Cell& cell = cells[pos.GetY() * width + pos.GetX()];
-
-	DrawCell(pos, cell.GetColor());
+	DrawCell(pos, GetCell(pos).GetColor());
 }
 
-void Board::DrawCell(Vec2<int> pos, Color color) const
+template<int W, int H>
+void BasicBoard<W, H>::DrawCell(Vec2<int> pos, Color color) const
 {
-	assert(pos.GetX() >= 0 && pos.GetX() < width && pos.GetY() >= 0 && pos.GetY() < height);
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
 	Vec2<int> topLeft = screenPos + padding + (pos * cellSize);
 	Vec2<int> paddedWidthHeight = Vec2<int>(cellSize, cellSize) - padding;
 
 	rayCpp::DrawRectangle(topLeft, paddedWidthHeight, color);
 }
 
-void Board::Draw() const
+template<int W, int H>
+void BasicBoard<W, H>::Draw() const
 {
-	for (int y = 0; y < height; ++y)
-		for (int x = 0; x < width; ++x) {
-			if (CellExists({ x,y }))
+	for (int y = 0; y < GetHeight(); ++y) {
+		const uint32_t mask = rows[RowIndex(y)].mask;
+		if (mask == 0)
+			continue;
+		for (int x = 0; x < GetWidth(); ++x) {
+			if (mask & (1u << x))
 				DrawCell(Vec2<int>(x, y));
 		}
+	}
 	DrawBorder();
 }
 
-void Board::Update()
+template<int W, int H>
+int BasicBoard<W, H>::Update(ParticleSystem& particles)
 {
-	for (int y = height - 1; y >= 0; --y) {
-		bool bRowFull = true;
-		for (int x = 0; x < width; ++x) {
-			if (!CellExists({ x,y })) {
-				bRowFull = false;
-				break;
-			}
+	return ClearFullRows(&particles);
+}
+
+template<int W, int H>
+int BasicBoard<W, H>::Update()
+{
+	// Same as above without the effects, for re-simulating ticks nobody watches
+	return ClearFullRows(nullptr);
+}
+
+template<int W, int H>
+int BasicBoard<W, H>::ClearFullRows(ParticleSystem* particles)
+{
+	int linesCleared = 0;
+	for (int y = GetHeight() - 1; y >= 0; --y) {
+		if (rows[RowIndex(y)].mask != fullRowMask)
+			continue;
+
+		++linesCleared;
+		for (int x = 0; particles && x < GetWidth(); ++x) {
+			EmitCellParticles({ x,y }, GetCell({ x,y }).GetColor(), *particles, settings::lineClearParticlesPerCell);
+		}
+		ClearRow(y);
+		// The row above has moved into y, check it again
+		++y;
+	}
+	return linesCleared;
+}
+
+template<int W, int H>
+void BasicBoard<W, H>::ClearRow(int y)
+{
+	assert(y >= 0 && y < GetHeight());
+	Row cleared = rows[RowIndex(y)];
+	const uint64_t clearedKey = zobrist::RowKey(y, cleared.mask);
+	cleared.mask = 0;
+	++revision;
+
+	// Shift whichever side of the cleared row has fewer records. Only the rows above move
+	// down, but their keys can be found from either side: below the cleared row the hash
+	// stays put, and the part above is what is left once that and the cleared row are taken out.
+	if (y < GetHeight() / 2) {
+		// Rows above drop by one, the cleared record becomes the new top row
+		uint64_t above = 0;
+		for (int y2 = y; y2 > 0; --y2) {
+			rows[RowIndex(y2)] = rows[RowIndex(y2 - 1)];
+			above ^= zobrist::RowKey(y2 - 1, rows[RowIndex(y2)].mask);
 		}
-		if (bRowFull) {
-			for (int x = 0; x < width; ++x) {
-				RemoveCell(Vec2<int>(x, y));
-			}
-			for (int y2 = y - 1; y2 >= 0; --y2) {
-				for (int x = 0; x < width; ++x) {
-					if (CellExists({ x,y2 })) {
-						Color c = cells[y2 * width + x].GetColor();
-						RemoveCell(Vec2<int>(x, y2));
-						SetCell({ x,y2 + 1 }, c);
-					}
-				}
-			}
-			++y;
+		rows[RowIndex(0)] = cleared;
+		hash ^= clearedKey ^ above ^ zobrist::RotateLeft(above, 1);
+	}
+	else {
+		// Rows below close the gap towards the bottom of the ring, then the ring
+		// rotates back by one so the freed bottom record wraps around to the top
+		uint64_t below = 0;
+		for (int y2 = y; y2 < GetHeight() - 1; ++y2) {
+			rows[RowIndex(y2)] = rows[RowIndex(y2 + 1)];
+			below ^= zobrist::RowKey(y2 + 1, rows[RowIndex(y2)].mask);
+		}
+		rows[RowIndex(GetHeight() - 1)] = cleared;
+		rowHead = RowIndex(GetHeight() - 1);
+		const uint64_t above = hash ^ clearedKey ^ below;
+		hash = zobrist::RotateLeft(above, 1) ^ below;
+	}
+	assert(hash == ComputeHash());
+}
+
+template<int W, int H>
+bool BasicBoard<W, H>::InsertGarbageRows(int count, int holeColumn, Color c)
+{
+	assert(count >= 0 && holeColumn >= 0 && holeColumn < GetWidth());
+	bool bToppedOut = false;
+	++revision;
+	for (int n = 0; n < count; ++n) {
+		// Rotating the ring by one recycles the top row as the new bottom row
+		// and moves every other row up by one, which rotates their keys back by one
+		bToppedOut |= rows[RowIndex(0)].mask != 0;
+		hash = zobrist::RotateRight(hash ^ zobrist::RowKey(0, rows[RowIndex(0)].mask), 1);
+		rowHead = RowIndex(1);
+
+		Row& row = rows[RowIndex(GetHeight() - 1)];
+		row.mask = static_cast<RowMask>(fullRowMask & ~(1u << holeColumn));
+		hash ^= zobrist::RowKey(GetHeight() - 1, row.mask);
+		for (int x = 0; x < GetWidth(); ++x) {
+			cells[row.offset + x].SetColor(c);
 		}
 	}
+	assert(hash == ComputeHash());
+	return bToppedOut;
 }
 
-void Board::DrawBorder() const
+template<int W, int H>
+void BasicBoard<W, H>::DrawBorder() const
 {
 	Vec2<int> topLeft = screenPos - (cellSize / 2);
-	Vec2<int> widthHeight = Vec2<int>(width, height) * cellSize + cellSize;
+	Vec2<int> widthHeight = Vec2<int>(GetWidth(), GetHeight()) * cellSize + cellSize;
 	rayCpp::DrawRectangleLinesEx(topLeft, widthHeight, cellSize / 2, WHITE);
 }
 
-bool Board::CellExists(Vec2<int> pos) const
+template<int W, int H>
+Color BasicBoard<W, H>::GetCellColor(Vec2<int> pos) const
 {
-	assert(pos.GetX() >= 0 && pos.GetX() < width && pos.GetY() >= 0 && pos.GetY() < height);
-	return cells[pos.GetY() * width + pos.GetX()].Exists();
+	return GetCell(pos).GetColor();
 }
 
-void Board::SetCell(Vec2<int> pos, Color c)
+template<int W, int H>
+void BasicBoard<W, H>::SetCell(Vec2<int> pos, Color c)
 {
-	assert(pos.GetX() >= 0 && pos.GetX() < width && pos.GetY() >= 0 && pos.GetY() < height);
-	cells[pos.GetY() * width + pos.GetX()].SetColor(c);
-	cells[pos.GetY() * width + pos.GetX()].Add();
+	GetCell(pos).SetColor(c);
+	SetRowMask(pos.GetY(), GetRowMask(pos.GetY()) | 1u << pos.GetX());
+	++revision;
+	assert(hash == ComputeHash());
 }
 
-void Board::RemoveCell(Vec2<int> pos)
+template<int W, int H>
+void BasicBoard<W, H>::RemoveCell(Vec2<int> pos)
 {
-	assert(pos.GetX() >= 0 && pos.GetX() < width && pos.GetY() >= 0 && pos.GetY() < height);
-	cells[pos.GetY() * width + pos.GetX()].Remove();
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
+	SetRowMask(pos.GetY(), GetRowMask(pos.GetY()) & ~(1u << pos.GetX()));
+	++revision;
+	assert(hash == ComputeHash());
 }
 
-int Board::GetWidth() const
+template<int W, int H>
+void BasicBoard<W, H>::EmitCellParticles(Vec2<int> pos, Color color, ParticleSystem& particles, int count) const
 {
-	return width;
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
+	Vec2<int> center = screenPos + padding + (pos * cellSize) + cellSize / 2;
+	particles.Emit({ (float)center.GetX(), (float)center.GetY() }, color, count, settings::particleSpeed);
 }
 
-int Board::GetHeight() const
+template<int W, int H>
+void BasicBoard<W, H>::EmitBoardParticles(ParticleSystem& particles, int countPerCell) const
 {
-	return height;
+	for (int y = 0; y < GetHeight(); ++y)
+		for (int x = 0; x < GetWidth(); ++x) {
+			if (CellExists({ x,y }))
+				EmitCellParticles({ x,y }, GetCell({ x,y }).GetColor(), particles, countPerCell);
+		}
 }
 
-void Board::Reset()
+template<int W, int H>
+Vec2<int> BasicBoard<W, H>::ScreenToCell(Vector2 pos) const
 {
-	for (int y = 0; y < height; ++y)
-		for (int x = 0; x < width; ++x) {
-			RemoveCell(Vec2<int>(x, y));
-		}
+	const int x = static_cast<int>(std::floor((pos.x - screenPos.GetX() - padding) / cellSize));
+	const int y = static_cast<int>(std::floor((pos.y - screenPos.GetY() - padding) / cellSize));
+	return { std::clamp(x, 0, GetWidth() - 1), std::clamp(y, 0, GetHeight() - 1) };
+}
+
+template<int W, int H>
+unsigned int BasicBoard<W, H>::GetRevision() const
+{
+	return revision;
 }
+
+template<int W, int H>
+uint64_t BasicBoard<W, H>::GetHash() const
+{
+	return hash;
+}
+
+template<int W, int H>
+uint64_t BasicBoard<W, H>::ComputeHash() const
+{
+	uint64_t h = 0;
+	for (int y = 0; y < GetHeight(); ++y) {
+		h ^= zobrist::RowKey(y, rows[RowIndex(y)].mask);
+	}
+	return h;
+}
+
+template<int W, int H>
+void BasicBoard<W, H>::Reset()
+{
+	for (Row& row : rows) {
+		row.mask = 0;
+	}
+	hash = 0;
+	++revision;
+}
+
+template class BasicBoard<settings::boardWidthHeight.GetX(), settings::boardWidthHeight.GetY()>;
+template class BasicBoard<>;
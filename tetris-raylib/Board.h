@@ -1,45 +1,156 @@
 #pragma once
 #include "raylibCpp.h"
+#include <array>
 #include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <cassert>
 #include "Vec2.h"
+#include "ParticleSystem.h"
+#include "Settings.h"
+#include "Zobrist.h"
 
-class Board
+// Width and height of a board whose size is only known at run time
+inline constexpr int dynamicBoardSize = 0;
+
+// Where a board keeps its size: nowhere when the template fixes it, so a fixed size
+// board carries no size members at all
+template<int W, int H>
+class BoardSize
+{
+protected:
+	explicit BoardSize(Vec2<int>) {}
+};
+
+template<>
+class BoardSize<dynamicBoardSize, dynamicBoardSize>
+{
+protected:
+	explicit BoardSize(Vec2<int> widthHeight) : width(widthHeight.GetX()), height(widthHeight.GetY()) {}
+	const int width;
+	const int height;
+};
+
+// The playfield. With a size fixed at compile time every loop over rows and columns
+// has constant bounds, cells and rows sit inline in the board and row masks take the
+// narrowest integer that holds a row. BasicBoard<> takes its size at run time instead.
+template<int W = dynamicBoardSize, int H = dynamicBoardSize>
+class BasicBoard : private BoardSize<W, H>
 {
+public:
+	static constexpr bool isFixedSize = W != dynamicBoardSize && H != dynamicBoardSize;
+	static_assert(isFixedSize || (W == dynamicBoardSize && H == dynamicBoardSize), "Fix both sizes or neither");
+	static_assert(W <= 32, "Row occupancy has to fit in a 32 bit mask");
+	static_assert(H <= zobrist::maxRows, "Row hash keys would repeat");
+	using RowMask = std::conditional_t<isFixedSize && W <= 8, uint8_t,
+		std::conditional_t<isFixedSize && W <= 16, uint16_t, uint32_t>>;
 private:
 	class Cell
 	{
 	public:
 		Cell();
 		void SetColor(Color c);
-		void Add();
-		void Remove();
-		bool Exists() const;
 
 		Color GetColor() const;
 	private:
-		bool bExists;
 		Color c;
 	};
+	// A row record points at a physical row of cells and caches its occupancy as a bitmask.
+	// Rows are kept in a ring, so clearing or inserting rows moves records, not cells.
+	struct Row
+	{
+		RowMask mask = 0;
+		int offset = 0;
+	};
+	using CellStorage = std::conditional_t<isFixedSize, std::array<Cell, W * H>, std::vector<Cell>>;
+	using RowStorage = std::conditional_t<isFixedSize, std::array<Row, H>, std::vector<Row>>;
 public:
-	Board(Vec2<int> screenPos, Vec2<int> widthHeight, int cellSize, int padding);
+	// A fixed size board takes its size from the template, widthHeight has to match it
+	BasicBoard(Vec2<int> screenPos, Vec2<int> widthHeight, int cellSize, int padding);
 	void DrawCell(Vec2<int> pos) const;
 	void DrawCell(Vec2<int> pos, Color color) const;
 	void Draw() const;
-	void Update();
+	int Update(ParticleSystem& particles);
+	int Update();
 	void DrawBorder() const;
 	bool CellExists(Vec2<int> pos) const;
+	// The cell under a screen position, clamped to the board
+	Vec2<int> ScreenToCell(Vector2 pos) const;
+	Color GetCellColor(Vec2<int> pos) const;
 	bool IsTopRowOccupied() const;
 	void SetCell(Vec2<int> pos, Color c);
 	void RemoveCell(Vec2<int> pos);
-	int GetWidth() const;
-	int GetHeight() const;
+	uint32_t GetRowMask(int y) const;
+	bool InsertGarbageRows(int count, int holeColumn, Color c);
+	void EmitCellParticles(Vec2<int> pos, Color color, ParticleSystem& particles, int count) const;
+	void EmitBoardParticles(ParticleSystem& particles, int countPerCell) const;
+	constexpr int GetWidth() const;
+	constexpr int GetHeight() const;
+	unsigned int GetRevision() const;
+	// Zobrist hash of the occupancy, kept up to date by every change to the cells
+	uint64_t GetHash() const;
+	uint64_t ComputeHash() const;
 
 	void Reset();
 private:
-	std::vector<Cell> cells;
-	const int width;
-	const int height;
+	int RowIndex(int y) const;
+	void SetRowMask(int y, uint32_t mask);
+	const Cell& GetCell(Vec2<int> pos) const;
+	Cell& GetCell(Vec2<int> pos);
+	void ClearRow(int y);
+	int ClearFullRows(ParticleSystem* particles);
+private:
+	CellStorage cells;
+	RowStorage rows;
+	int rowHead = 0;
+	unsigned int revision = 0;	// Bumped on every change to the cells
+	uint64_t hash = 0;
+	const RowMask fullRowMask;
 	const int cellSize;
 	Vec2<int> screenPos;
 	int padding;
-};
\ No newline at end of file
+};
+
+// The standard playfield
+using Board = BasicBoard<settings::boardWidthHeight.GetX(), settings::boardWidthHeight.GetY()>;
+// For custom sizes
+using DynamicBoard = BasicBoard<>;
+
+template<int W, int H>
+inline constexpr int BasicBoard<W, H>::GetWidth() const
+{
+	if constexpr (isFixedSize)
+		return W;
+	else
+		return this->width;
+}
+
+template<int W, int H>
+inline constexpr int BasicBoard<W, H>::GetHeight() const
+{
+	if constexpr (isFixedSize)
+		return H;
+	else
+		return this->height;
+}
+
+template<int W, int H>
+inline int BasicBoard<W, H>::RowIndex(int y) const
+{
+	const int i = rowHead + y;
+	return i >= GetHeight() ? i - GetHeight() : i;
+}
+
+template<int W, int H>
+inline bool BasicBoard<W, H>::CellExists(Vec2<int> pos) const
+{
+	assert(pos.GetX() >= 0 && pos.GetX() < GetWidth() && pos.GetY() >= 0 && pos.GetY() < GetHeight());
+	return (rows[RowIndex(pos.GetY())].mask >> pos.GetX()) & 1u;
+}
+
+template<int W, int H>
+inline uint32_t BasicBoard<W, H>::GetRowMask(int y) const
+{
+	assert(y >= 0 && y < GetHeight());
+	return rows[RowIndex(y)].mask;
+}
\ No newline at end of file
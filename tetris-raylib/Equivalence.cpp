@@ -0,0 +1,655 @@
+#include "Equivalence.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <thread>
+#include <assert.h>
+#include "Board.h"
+#include "Gravity.h"
+#include "Tetromino.h"
+#include "Zobrist.h"
+
+namespace
+{
+	constexpr uint64_t sequencesPerGrab = 64;
+	constexpr uint32_t fullRowMask = (1u << Equivalence::width) - 1;
+
+	// splitmix64, every sequence draws from its own stream
+	uint64_t NextRandom(uint64_t& state)
+	{
+		return zobrist::Mix(state += 0x9E3779B97F4A7C15ull);
+	}
+
+	// The bitboard engine, its observation buffers are its whole game state
+	class VecEnvEngine : public Equivalence::Engine
+	{
+	public:
+		VecEnvEngine()
+			:
+			env(1, { rows.data(), &pieceType, &pieceX, &pieceY, &pieceRotation, &reward, &done })
+		{
+		}
+		VecEnvEngine(const VecEnvEngine&) = delete;
+		VecEnvEngine& operator=(const VecEnvEngine&) = delete;
+		const char* GetName() const override
+		{
+			return "VecEnv";
+		}
+		void Reset(uint64_t seed, const uint32_t* garbage) override
+		{
+			env.Reset(&seed);
+			// The observation buffers are the engine's board, garbage goes straight in
+			if (garbage)
+			{
+				std::copy(garbage, garbage + Equivalence::height, rows.begin());
+			}
+			reward = 0.0f;
+			done = 0;
+		}
+		void Step(EnvAction action) override
+		{
+			const uint8_t actions = static_cast<uint8_t>(action);
+			env.Step(&actions);
+		}
+		void Observe(Equivalence::Observation& observation) const override
+		{
+			observation.rows = rows;
+			observation.pieceType = pieceType;
+			observation.pieceX = pieceX;
+			observation.pieceY = pieceY;
+			observation.pieceRotation = pieceRotation;
+			// Rewards are whole scores, exact in a float
+			observation.reward = static_cast<int>(reward);
+			observation.isDone = done != 0;
+			observation.randomizerState = env.GetRandomizerState(0);
+		}
+	private:
+		std::array<uint32_t, Equivalence::height> rows;
+		int32_t pieceType;
+		int32_t pieceX;
+		int32_t pieceY;
+		int32_t pieceRotation;
+		float reward;
+		uint8_t done;
+		VecEnv env;
+	};
+
+	// The live Board and Tetromino, stepped like Simulation::StepGameplay
+	template<typename BoardType>
+	class BoardEngine : public Equivalence::Engine
+	{
+	public:
+		explicit BoardEngine(const char* name)
+			:
+			name(name),
+			board(settings::boardPosition, settings::boardWidthHeight, settings::cellSize, settings::boardPadding)
+		{
+		}
+		const char* GetName() const override
+		{
+			return name;
+		}
+		void Reset(uint64_t seed, const uint32_t* garbage) override
+		{
+			board.Reset();
+			for (int y = 0; garbage && y < Equivalence::height; ++y)
+			{
+				for (int x = 0; x < Equivalence::width; ++x)
+				{
+					if ((garbage[y] >> x) & 1u)
+					{
+						board.SetCell({ x, y }, GRAY);
+					}
+				}
+			}
+			randomizer.SetState(seed);
+			elapsedTicks = 0;
+			speedLevel = settings::initialLevel;
+			reward = 0;
+			isDone = false;
+			piece.emplace(randomizer.Next(), board);
+		}
+		void Step(EnvAction action) override
+		{
+			reward = 0;
+			isDone = false;
+			switch (action)
+			{
+			case EnvAction::MoveLeft:
+				piece->MoveLeft();
+				break;
+			case EnvAction::MoveRight:
+				piece->MoveRight();
+				break;
+			case EnvAction::RotateClockwise:
+				piece->RotateClockwise();
+				break;
+			case EnvAction::RotateCounterClockwise:
+				piece->RotateCounterClockwise();
+				break;
+			case EnvAction::Drop:
+				piece->Drop();
+				break;
+			default:
+				break;
+			}
+
+			if (++elapsedTicks >= settings::ticksPerLevel * speedLevel)
+			{
+				++speedLevel;
+			}
+			piece->Tick(gravity::ForLevel(speedLevel));
+			if (!piece->HasLanded())
+				return;
+
+			piece->AddToBoard();
+			const int cleared = board.Update();
+			const int score = settings::lineClearScores[std::min(cleared, 4)] * speedLevel;
+			piece.emplace(randomizer.Next(), board);
+			if (board.IsTopRowOccupied())
+			{
+				// The next game carries on with the piece sequence
+				Reset(randomizer.GetState(), nullptr);
+				isDone = true;
+			}
+			reward = score;
+		}
+		void Observe(Equivalence::Observation& observation) const override
+		{
+			const typename BasicTetromino<BoardType>::State state = piece->GetState();
+			for (int y = 0; y < Equivalence::height; ++y)
+			{
+				observation.rows[y] = board.GetRowMask(y);
+			}
+			observation.pieceType = static_cast<int>(piece->GetType());
+			observation.pieceX = state.pos.GetX();
+			observation.pieceY = state.pos.GetY();
+			observation.pieceRotation = static_cast<int>(state.rotation) / 90;
+			observation.reward = reward;
+			observation.isDone = isDone;
+			observation.randomizerState = randomizer.GetState();
+		}
+	private:
+		const char* name;
+		BoardType board;
+		std::optional<BasicTetromino<BoardType>> piece;
+		PieceRandomizer randomizer;
+		int elapsedTicks = 0;
+		int speedLevel = settings::initialLevel;
+		int reward = 0;
+		bool isDone = false;
+	};
+}
+
+void Equivalence::ReferenceGame::Reset(uint64_t seed, const uint32_t* garbage)
+{
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			cells[y][x] = garbage && ((garbage[y] >> x) & 1u) != 0;
+		}
+	}
+	randomizer.SetState(seed);
+	elapsedTicks = 0;
+	speedLevel = settings::initialLevel;
+	reward = 0;
+	isDone = false;
+	Spawn(randomizer.Next());
+}
+
+void Equivalence::ReferenceGame::Spawn(PieceType type)
+{
+	// Centred at the top in the spawn orientation
+	this->type = type;
+	x = width / 2 - pieces::GetShape(type).dimension / 2;
+	y = 0;
+	rotation = 0;
+	gravityAccumulator = 0;
+	hasLanded = false;
+}
+
+bool Equivalence::ReferenceGame::IsCellAt(int x, int y, int rotation) const
+{
+	const pieces::Shape& shape = pieces::GetShape(type);
+	const int d = shape.dimension;
+	switch (rotation) {
+	case 0:
+		return shape.cells[y * d + x];
+	case 1:
+		return shape.cells[d * (d - 1) - d * x + y];
+	case 2:
+		return shape.cells[d * (d - y) - (x + 1)];
+	case 3:
+		return shape.cells[(d - 1) + d * x - y];
+	default:
+		return false;
+	}
+}
+
+bool Equivalence::ReferenceGame::IsColliding(int x, int y, int rotation) const
+{
+	const int dimension = pieces::GetShape(type).dimension;
+	for (int boxY = 0; boxY < dimension; ++boxY) {
+		for (int boxX = 0; boxX < dimension; ++boxX) {
+			if (IsCellAt(boxX, boxY, rotation)) {
+				const int cellX = x + boxX;
+				const int cellY = y + boxY;
+				if (cellX < 0 || cellX >= width || cellY < 0 || cellY >= height || cells[cellY][cellX]) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void Equivalence::ReferenceGame::Rotate(int to)
+{
+	// The first kick that fits wins, the piece stays put if none does
+	const pieces::KickList& kicks = pieces::GetKicks(type, rotation, to);
+	for (int i = 0; i < kicks.count; ++i)
+	{
+		if (!IsColliding(x + kicks.kicks[i].x, y + kicks.kicks[i].y, to))
+		{
+			x += kicks.kicks[i].x;
+			y += kicks.kicks[i].y;
+			rotation = to;
+			return;
+		}
+	}
+}
+
+void Equivalence::ReferenceGame::Tick(int32_t gravity)
+{
+	if (hasLanded)
+		return;
+
+	// One row per whole row accumulated, landing on the first one that doesn't fit
+	gravityAccumulator += gravity;
+	while (gravityAccumulator >= gravity::oneRow)
+	{
+		gravityAccumulator -= gravity::oneRow;
+		if (IsColliding(x, y + 1, rotation))
+		{
+			hasLanded = true;
+			gravityAccumulator = 0;
+		}
+		else
+		{
+			++y;
+		}
+	}
+}
+
+int Equivalence::ReferenceGame::ClearFullRows()
+{
+	int cleared = 0;
+	for (int y = height - 1; y >= 0; --y)
+	{
+		if (std::find(cells[y].begin(), cells[y].end(), false) != cells[y].end())
+			continue;
+
+		++cleared;
+		for (int above = y; above > 0; --above)
+		{
+			cells[above] = cells[above - 1];
+		}
+		cells[0].fill(false);
+		// The row above has moved into y, check it again
+		++y;
+	}
+	return cleared;
+}
+
+void Equivalence::ReferenceGame::Step(EnvAction action)
+{
+	reward = 0;
+	isDone = false;
+	++totals.ticks;
+	switch (action)
+	{
+	case EnvAction::MoveLeft:
+		x -= IsColliding(x - 1, y, rotation) ? 0 : 1;
+		break;
+	case EnvAction::MoveRight:
+		x += IsColliding(x + 1, y, rotation) ? 0 : 1;
+		break;
+	case EnvAction::RotateClockwise:
+		Rotate((rotation + 1) % pieces::rotationCount);
+		break;
+	case EnvAction::RotateCounterClockwise:
+		Rotate((rotation + pieces::rotationCount - 1) % pieces::rotationCount);
+		break;
+	case EnvAction::Drop:
+		y += IsColliding(x, y + 1, rotation) ? 0 : 1;
+		break;
+	default:
+		break;
+	}
+
+	if (++elapsedTicks >= settings::ticksPerLevel * speedLevel)
+	{
+		++speedLevel;
+	}
+	Tick(gravity::ForLevel(speedLevel));
+	if (!hasLanded)
+		return;
+
+	const int dimension = pieces::GetShape(type).dimension;
+	for (int boxY = 0; boxY < dimension; ++boxY)
+	{
+		for (int boxX = 0; boxX < dimension; ++boxX)
+		{
+			if (IsCellAt(boxX, boxY, rotation))
+			{
+				cells[y + boxY][x + boxX] = true;
+			}
+		}
+	}
+	const int cleared = ClearFullRows();
+	const int score = settings::lineClearScores[std::min(cleared, 4)] * speedLevel;
+	Spawn(randomizer.Next());
+	++totals.locks;
+	totals.lines += cleared;
+
+	if (std::find(cells[0].begin(), cells[0].end(), true) != cells[0].end())
+	{
+		// The next game carries on with the piece sequence
+		++totals.topOuts;
+		Reset(randomizer.GetState(), nullptr);
+		isDone = true;
+	}
+	reward = score;
+}
+
+void Equivalence::ReferenceGame::Observe(Observation& observation) const
+{
+	for (int y = 0; y < height; ++y)
+	{
+		observation.rows[y] = 0;
+		for (int x = 0; x < width; ++x)
+		{
+			observation.rows[y] |= cells[y][x] ? 1u << x : 0u;
+		}
+	}
+	observation.pieceType = static_cast<int>(type);
+	observation.pieceX = x;
+	observation.pieceY = y;
+	observation.pieceRotation = rotation;
+	observation.reward = reward;
+	observation.isDone = isDone;
+	observation.randomizerState = randomizer.GetState();
+}
+
+Equivalence::Worker::Worker()
+{
+	engines.push_back(std::make_unique<VecEnvEngine>());
+	engines.push_back(std::make_unique<BoardEngine<Board>>("Board"));
+	engines.push_back(std::make_unique<BoardEngine<DynamicBoard>>("DynamicBoard"));
+}
+
+
+bool Equivalence::Run(uint64_t sequenceCount, int tickCount, uint64_t seed, int threadCount)
+{
+	assert(sequenceCount > 0 && tickCount > 0 && threadCount >= 1);
+	const auto start = std::chrono::steady_clock::now();
+	this->sequenceCount = sequenceCount;
+	this->tickCount = tickCount;
+	this->seed = seed;
+	while (static_cast<int>(workers.size()) < threadCount)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+	for (std::unique_ptr<Worker>& worker : workers)
+	{
+		worker->reference.totals = {};
+	}
+
+	nextSequence = 0;
+	firstMismatch = sequenceCount;
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back([this, i]() { RunWorker(*workers[i]); });
+	}
+	RunWorker(*workers[0]);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	totals = {};
+	for (int i = 0; i < threadCount; ++i)
+	{
+		const Totals& workerTotals = workers[i]->reference.totals;
+		totals.sequences += workerTotals.sequences;
+		totals.ticks += workerTotals.ticks;
+		totals.locks += workerTotals.locks;
+		totals.lines += workerTotals.lines;
+		totals.topOuts += workerTotals.topOuts;
+	}
+
+	const bool isEquivalent = firstMismatch == sequenceCount;
+	if (!isEquivalent)
+	{
+		Minimize(*workers[0]);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return isEquivalent;
+}
+
+const Equivalence::Mismatch& Equivalence::GetMismatch() const
+{
+	return mismatch;
+}
+
+const Equivalence::Totals& Equivalence::GetTotals() const
+{
+	return totals;
+}
+
+double Equivalence::GetSeconds() const
+{
+	return seconds;
+}
+
+std::string Equivalence::FormatActions(const std::vector<uint8_t>& actions)
+{
+	std::string letters;
+	letters.reserve(actions.size());
+	for (uint8_t action : actions)
+	{
+		letters += action < static_cast<uint8_t>(EnvAction::Count) ? actionLetters[action] : '?';
+	}
+	return letters;
+}
+
+void Equivalence::RunWorker(Worker& worker)
+{
+	Sequence sequence;
+	int tick = 0;
+	const char* engine = nullptr;
+	std::string difference;
+	// Sequences past a known mismatch are skipped, the ones before it still have to be played
+	for (uint64_t first = nextSequence.fetch_add(sequencesPerGrab); first < firstMismatch; first = nextSequence.fetch_add(sequencesPerGrab))
+	{
+		const uint64_t last = std::min(first + sequencesPerGrab, sequenceCount);
+		for (uint64_t i = first; i < last && i < firstMismatch; ++i)
+		{
+			GenerateSequence(i, sequence);
+			++worker.reference.totals.sequences;
+			if (Matches(worker, sequence, tick, engine, difference))
+				continue;
+
+			std::lock_guard<std::mutex> lock(mismatchMutex);
+			if (i < firstMismatch)
+			{
+				mismatch = { i, sequence, tick, engine, difference };
+				firstMismatch = i;
+			}
+			break;
+		}
+	}
+}
+
+void Equivalence::GenerateSequence(uint64_t index, Sequence& sequence) const
+{
+	uint64_t state = zobrist::Mix(seed + index);
+	sequence.seed = NextRandom(state);
+
+	// Garbage in the bottom half with one hole per row, often in the column of the row
+	// below, so random play clears lines and tops out well within a sequence
+	sequence.garbage.fill(0u);
+	const int garbageRows = static_cast<int>(NextRandom(state) % (height / 2 + 1));
+	int hole = static_cast<int>(NextRandom(state) % width);
+	for (int y = height - 1; y >= height - garbageRows; --y)
+	{
+		const uint64_t r = NextRandom(state);
+		if (r & 1u)
+		{
+			hole = static_cast<int>((r >> 1) % width);
+		}
+		sequence.garbage[y] = fullRowMask & ~(1u << hole);
+	}
+
+	sequence.actions.resize(tickCount);
+	for (uint8_t& action : sequence.actions)
+	{
+		action = static_cast<uint8_t>(NextRandom(state) % static_cast<uint64_t>(EnvAction::Count));
+	}
+}
+
+bool Equivalence::Matches(Worker& worker, const Sequence& sequence, int& tick, const char*& engine, std::string& difference)
+{
+	worker.reference.Reset(sequence.seed, sequence.garbage.data());
+	for (std::unique_ptr<Engine>& e : worker.engines)
+	{
+		e->Reset(sequence.seed, sequence.garbage.data());
+	}
+
+	for (tick = 0; tick <= static_cast<int>(sequence.actions.size()); ++tick)
+	{
+		if (tick > 0)
+		{
+			const EnvAction action = static_cast<EnvAction>(sequence.actions[tick - 1]);
+			worker.reference.Step(action);
+			for (std::unique_ptr<Engine>& e : worker.engines)
+			{
+				e->Step(action);
+			}
+		}
+		worker.reference.Observe(worker.expected);
+		for (std::unique_ptr<Engine>& e : worker.engines)
+		{
+			e->Observe(worker.actual);
+			if (!Compare(worker.expected, worker.actual, difference))
+			{
+				engine = e->GetName();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Equivalence::Compare(const Observation& expected, const Observation& actual, std::string& difference)
+{
+	char text[128];
+	bool isEqual = true;
+	auto check = [&](const char* field, int64_t expectedValue, int64_t actualValue) {
+		if (isEqual && expectedValue != actualValue)
+		{
+			std::snprintf(text, sizeof(text), "%s: reference %lld, engine %lld", field,
+				static_cast<long long>(expectedValue), static_cast<long long>(actualValue));
+			isEqual = false;
+		}
+	};
+	for (int y = 0; y < height && isEqual; ++y)
+	{
+		if (expected.rows[y] != actual.rows[y])
+		{
+			std::snprintf(text, sizeof(text), "row %d: reference 0x%03x, engine 0x%03x", y, expected.rows[y], actual.rows[y]);
+			isEqual = false;
+		}
+	}
+	check("piece type", expected.pieceType, actual.pieceType);
+	check("piece x", expected.pieceX, actual.pieceX);
+	check("piece y", expected.pieceY, actual.pieceY);
+	check("piece rotation", expected.pieceRotation, actual.pieceRotation);
+	check("reward", expected.reward, actual.reward);
+	check("done", expected.isDone, actual.isDone);
+	check("randomizer", static_cast<int64_t>(expected.randomizerState), static_cast<int64_t>(actual.randomizerState));
+	if (!isEqual)
+	{
+		difference = text;
+	}
+	return isEqual;
+}
+
+void Equivalence::Minimize(Worker& worker)
+{
+	// Nothing after the first difference matters
+	mismatch.sequence.actions.resize(mismatch.tick);
+
+	// A removal shifts everything after it, so one that failed may work after another
+	// succeeded, repeat until nothing can go
+	const uint8_t none = static_cast<uint8_t>(EnvAction::None);
+	for (bool isShrinking = true; isShrinking;)
+	{
+		isShrinking = false;
+		// Ever smaller chunks of actions, a removal that keeps a difference stays
+		for (size_t chunk = std::max<size_t>(mismatch.sequence.actions.size() / 2, 1); chunk > 0; chunk /= 2)
+		{
+			for (size_t start = 0; start < mismatch.sequence.actions.size();)
+			{
+				Sequence candidate = mismatch.sequence;
+				const size_t end = std::min(start + chunk, candidate.actions.size());
+				candidate.actions.erase(candidate.actions.begin() + start, candidate.actions.begin() + end);
+				if (TryCandidate(worker, candidate, mismatch))
+				{
+					isShrinking = true;
+				}
+				else
+				{
+					start += chunk;
+				}
+			}
+		}
+
+		// Then the plainest inputs that still do it
+		for (size_t i = 0; i < mismatch.sequence.actions.size(); ++i)
+		{
+			if (mismatch.sequence.actions[i] == none)
+				continue;
+			Sequence candidate = mismatch.sequence;
+			candidate.actions[i] = none;
+			isShrinking |= TryCandidate(worker, candidate, mismatch);
+		}
+		for (int y = 0; y < height; ++y)
+		{
+			if (mismatch.sequence.garbage[y] == 0)
+				continue;
+			Sequence candidate = mismatch.sequence;
+			candidate.garbage[y] = 0;
+			isShrinking |= TryCandidate(worker, candidate, mismatch);
+		}
+	}
+}
+
+bool Equivalence::TryCandidate(Worker& worker, const Sequence& candidate, Mismatch& mismatch)
+{
+	int tick = 0;
+	const char* engine = nullptr;
+	std::string difference;
+	if (Matches(worker, candidate, tick, engine, difference))
+		return false;
+
+	mismatch.sequence = candidate;
+	mismatch.sequence.actions.resize(tick);
+	mismatch.tick = tick;
+	mismatch.engine = engine;
+	mismatch.difference = difference;
+	return true;
+}
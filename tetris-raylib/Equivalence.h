@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Pieces.h"
+#include "Settings.h"
+#include "VecEnv.h"
+
+// Differential check of the rules engines against a frozen reference. The reference is
+// a copy of the rules as Board and Tetromino had them before they became templates on
+// row masks: a plain grid of cells and the piece tested against it cell by cell. It is
+// what the engines are held to, so it is never optimized. Only the piece shape and kick
+// tables are shared with them. Every engine behind the Engine interface plays the same
+// random input sequences on every core, stepped and reset the way VecEnv documents it,
+// one action then one gravity tick. Their boards, pieces, randomizers, line clear rewards
+// and top outs are compared with the reference after every tick. Checked today are the
+// bitboard VecEnv and the live Board and Tetromino, on both the fixed and the dynamic board.
+//
+// Sequences follow only from the run seed and their index, so a failing run reports
+// the lowest failing index whatever the thread count. That sequence is then shrunk
+// while an engine still disagrees: cut after the first difference, chunks of actions
+// removed, the rest turned into no action and the garbage rows emptied, over and over
+// until none of that keeps the difference. Desktop only.
+class Equivalence
+{
+public:
+	static constexpr int width = VecEnv::width;
+	static constexpr int height = VecEnv::height;
+	// Action letters for reports, indexed by EnvAction
+	static constexpr char actionLetters[] = ".LRCAD";
+	static_assert(sizeof(actionLetters) - 1 == static_cast<int>(EnvAction::Count));
+
+	// Everything a run of the engines depends on
+	struct Sequence
+	{
+		uint64_t seed;	// Randomizer state of the first game
+		std::array<uint32_t, height> garbage;	// Settled cells of the first game before any piece locks
+		std::vector<uint8_t> actions;	// EnvAction per tick
+	};
+	struct Mismatch
+	{
+		uint64_t index;	// Of the sequence in the run
+		Sequence sequence;	// Minimized
+		int tick;	// Steps into the minimized sequence, zero is the state after the reset
+		const char* engine;	// The first one to disagree
+		std::string difference;
+	};
+	// Of the reference games, to tell how much of the rules the run covered
+	struct Totals
+	{
+		uint64_t sequences;
+		uint64_t ticks;
+		uint64_t locks;
+		uint64_t lines;
+		uint64_t topOuts;
+	};
+	// What the engines are compared on after every tick
+	struct Observation
+	{
+		std::array<uint32_t, height> rows;
+		int pieceType;
+		int pieceX;
+		int pieceY;
+		int pieceRotation;	// Clockwise quarter turns
+		int reward;
+		bool isDone;
+		uint64_t randomizerState;
+	};
+	// A rules engine under test, running a single game
+	class Engine
+	{
+	public:
+		virtual ~Engine() = default;
+		virtual const char* GetName() const = 0;
+		// Starts a game from a randomizer state with garbage settled on the board
+		virtual void Reset(uint64_t seed, const uint32_t* garbage) = 0;
+		// The action, then one gravity tick. A top out resets from the randomizer state.
+		virtual void Step(EnvAction action) = 0;
+		virtual void Observe(Observation& observation) const = 0;
+	};
+public:
+	// Plays sequenceCount sequences of tickCount ticks. False on a mismatch, see GetMismatch.
+	bool Run(uint64_t sequenceCount, int tickCount, uint64_t seed, int threadCount);
+	const Mismatch& GetMismatch() const;
+	const Totals& GetTotals() const;
+	double GetSeconds() const;
+	static std::string FormatActions(const std::vector<uint8_t>& actions);
+private:
+	// The frozen rules, see above
+	struct ReferenceGame
+	{
+		void Reset(uint64_t seed, const uint32_t* garbage);
+		void Step(EnvAction action);
+		void Observe(Observation& observation) const;
+		void Spawn(PieceType type);
+		// Whether the box cell (x, y) of the piece is filled, turned clockwise rotation times
+		bool IsCellAt(int x, int y, int rotation) const;
+		bool IsColliding(int x, int y, int rotation) const;
+		void Rotate(int to);
+		void Tick(int32_t gravity);
+		// Full rows are removed and the rows above them move down
+		int ClearFullRows();
+
+		std::array<std::array<bool, width>, height> cells;
+		PieceType type;
+		int x;
+		int y;
+		int rotation;
+		int32_t gravityAccumulator;
+		bool hasLanded;
+		PieceRandomizer randomizer;
+		int elapsedTicks = 0;
+		int speedLevel = settings::initialLevel;
+		int reward = 0;
+		bool isDone = false;
+		Totals totals = {};
+	};
+	struct Worker
+	{
+		Worker();
+
+		ReferenceGame reference;
+		std::vector<std::unique_ptr<Engine>> engines;
+		Observation expected;
+		Observation actual;
+	};
+
+	void RunWorker(Worker& worker);
+	void GenerateSequence(uint64_t index, Sequence& sequence) const;
+	// Plays the sequence on the reference and every engine, false with the tick, engine
+	// and difference at the first mismatch
+	static bool Matches(Worker& worker, const Sequence& sequence, int& tick, const char*& engine, std::string& difference);
+	static bool Compare(const Observation& expected, const Observation& actual, std::string& difference);
+	void Minimize(Worker& worker);
+	// Keeps candidate if an engine still disagrees on it
+	static bool TryCandidate(Worker& worker, const Sequence& candidate, Mismatch& mismatch);
+private:
+	std::vector<std::unique_ptr<Worker>> workers;
+	uint64_t sequenceCount = 0;
+	int tickCount = 0;
+	uint64_t seed = 0;
+	std::atomic<uint64_t> nextSequence = 0;
+	std::atomic<uint64_t> firstMismatch = 0;	// Index, sequenceCount while none
+	std::mutex mismatchMutex;
+	Mismatch mismatch;
+	Totals totals = {};
+	double seconds = 0.0;
+};
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "FeatureCheck.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <assert.h>
+#include "Settings.h"
+#include "Zobrist.h"
+
+namespace
+{
+	constexpr int standardWidth = settings::boardWidthHeight.GetX();
+	constexpr int standardHeight = settings::boardWidthHeight.GetY();
+	constexpr size_t maxTimedBoards = 4096;
+	// Column entries past the width have to come back as they went in
+	constexpr uint8_t untouched = 0xAB;
+
+	// splitmix64, every board draws from its own stream
+	uint64_t NextRandom(uint64_t& state)
+	{
+		return zobrist::Mix(state += 0x9E3779B97F4A7C15ull);
+	}
+}
+
+bool FeatureCheck::Run(uint64_t boardCount, uint64_t seed)
+{
+	assert(boardCount > 0);
+	standardBoards.clear();
+	Mismatch board;
+	heuristics::BoardFeatures expected;
+	heuristics::BoardFeatures actual;
+	for (uint64_t i = 0; i < boardCount; ++i)
+	{
+		GenerateBoard(seed, i, board);
+		CountCells(board.rows.data(), board.width, board.height, expected);
+		std::memset(&actual, untouched, sizeof(actual));
+		heuristics::ExtractFeatures(board.rows.data(), board.width, board.height, actual);
+		if (!Compare(expected, actual, board.width, board.difference))
+		{
+			mismatch = board;
+			return false;
+		}
+		if (board.width == standardWidth && board.height == standardHeight && standardBoards.size() < maxTimedBoards * standardHeight)
+		{
+			standardBoards.insert(standardBoards.end(), board.rows.begin(), board.rows.begin() + standardHeight);
+		}
+	}
+	if (standardBoards.empty())
+		return true;
+
+	const size_t timedBoards = standardBoards.size() / standardHeight;
+	featureSum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < boardCount; ++i)
+	{
+		heuristics::ExtractFeatures(&standardBoards[(i % timedBoards) * standardHeight], standardWidth, standardHeight, actual);
+		featureSum += actual.holes + actual.wellSum;
+	}
+	nanosecondsPerBoard = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / boardCount;
+	return true;
+}
+
+const FeatureCheck::Mismatch& FeatureCheck::GetMismatch() const
+{
+	return mismatch;
+}
+
+double FeatureCheck::GetNanosecondsPerBoard() const
+{
+	return nanosecondsPerBoard;
+}
+
+void FeatureCheck::GenerateBoard(uint64_t seed, uint64_t index, Mismatch& board)
+{
+	uint64_t state = zobrist::Mix(seed + index);
+	board.index = index;
+	board.rows.fill(0u);
+	if (NextRandom(state) & 1u)
+	{
+		board.width = standardWidth;
+		board.height = standardHeight;
+	}
+	else
+	{
+		board.width = 1 + static_cast<int>(NextRandom(state) % heuristics::maxWidth);
+		board.height = 1 + static_cast<int>(NextRandom(state) % heuristics::maxHeight);
+	}
+	const int width = board.width;
+	const int height = board.height;
+	const uint32_t fullRow = (1u << width) - 1;
+
+	if (NextRandom(state) % 4 == 0)
+	{
+		// Noise below a few empty rows, floating cells and all
+		const int emptyRows = static_cast<int>(NextRandom(state) % (height + 1));
+		for (int y = emptyRows; y < height; ++y)
+		{
+			board.rows[y] = static_cast<uint32_t>(NextRandom(state)) & fullRow;
+		}
+		return;
+	}
+
+	// A stack per column, with one cell in eight left open as a hole
+	const int maxStack = 1 + static_cast<int>(NextRandom(state) % height);
+	for (int x = 0; x < width; ++x)
+	{
+		const int stack = static_cast<int>(NextRandom(state) % (maxStack + 1));
+		for (int y = height - stack; y < height; ++y)
+		{
+			if (NextRandom(state) % 8 != 0)
+			{
+				board.rows[y] |= 1u << x;
+			}
+		}
+	}
+}
+
+void FeatureCheck::CountCells(const uint32_t* rows, int width, int height, heuristics::BoardFeatures& features)
+{
+	const auto isFilled = [&](int x, int y) {
+		// The walls and the floor count as filled
+		return x < 0 || x >= width || y >= height || ((rows[y] >> x) & 1u) != 0;
+	};
+
+	features = {};
+	for (int x = 0; x < width; ++x)
+	{
+		int columnHeight = 0;
+		for (int y = height - 1; y >= 0; --y)
+		{
+			if (isFilled(x, y))
+			{
+				columnHeight = height - y;
+			}
+		}
+		features.columnHeights[x] = static_cast<uint8_t>(columnHeight);
+		features.aggregateHeight += columnHeight;
+		features.maxColumnHeight = std::max(features.maxColumnHeight, columnHeight);
+
+		for (int y = 0; y < height; ++y)
+		{
+			bool isFilledAbove = false;
+			for (int above = 0; above < y; ++above)
+			{
+				isFilledAbove = isFilledAbove || isFilled(x, above);
+			}
+			bool isHoleBelow = false;
+			for (int below = y + 1; below < height; ++below)
+			{
+				isHoleBelow = isHoleBelow || !isFilled(x, below);
+			}
+			features.holes += !isFilled(x, y) && isFilledAbove;
+			features.coveredCells += isFilled(x, y) && isHoleBelow;
+			// Against the cell below, the last row against the floor
+			features.columnTransitions += isFilled(x, y) != isFilled(x, y + 1);
+		}
+	}
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x <= width; ++x)
+		{
+			features.rowTransitions += isFilled(x - 1, y) != isFilled(x, y);
+		}
+	}
+
+	for (int x = 0; x < width; ++x)
+	{
+		const int left = x > 0 ? features.columnHeights[x - 1] : height;
+		const int right = x + 1 < width ? features.columnHeights[x + 1] : height;
+		const int wellDepth = std::max(0, std::min(left, right) - features.columnHeights[x]);
+		features.wellDepths[x] = static_cast<uint8_t>(wellDepth);
+		features.wellSum += wellDepth;
+		features.bumpiness += x > 0 ? std::abs(features.columnHeights[x] - left) : 0;
+	}
+}
+
+bool FeatureCheck::Compare(const heuristics::BoardFeatures& expected, const heuristics::BoardFeatures& actual, int width, std::string& difference)
+{
+	char text[128];
+	bool isEqual = true;
+	auto check = [&](const char* field, int x, int counted, int extracted) {
+		if (isEqual && counted != extracted)
+		{
+			if (x < 0)
+				std::snprintf(text, sizeof(text), "%s: per cell %d, extracted %d", field, counted, extracted);
+			else
+				std::snprintf(text, sizeof(text), "%s of column %d: per cell %d, extracted %d", field, x, counted, extracted);
+			isEqual = false;
+		}
+	};
+	for (int x = 0; x < heuristics::maxWidth; ++x)
+	{
+		check("height", x, x < width ? expected.columnHeights[x] : untouched, actual.columnHeights[x]);
+		check("well depth", x, x < width ? expected.wellDepths[x] : untouched, actual.wellDepths[x]);
+	}
+	check("aggregate height", -1, expected.aggregateHeight, actual.aggregateHeight);
+	check("max column height", -1, expected.maxColumnHeight, actual.maxColumnHeight);
+	check("holes", -1, expected.holes, actual.holes);
+	check("covered cells", -1, expected.coveredCells, actual.coveredCells);
+	check("row transitions", -1, expected.rowTransitions, actual.rowTransitions);
+	check("column transitions", -1, expected.columnTransitions, actual.columnTransitions);
+	check("bumpiness", -1, expected.bumpiness, actual.bumpiness);
+	check("well sum", -1, expected.wellSum, actual.wellSum);
+	if (!isEqual)
+	{
+		difference = text;
+	}
+	return isEqual;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Heuristics.h"
+
+// Cross-check and benchmark of heuristics::ExtractFeatures. Every feature is counted
+// again cell by cell, the way the definitions in Heuristics.h read, on random boards of
+// every width and height up to the limits. Half of them are the standard board, which
+// takes the table path, the rest take the popcount path. Boards are stacks with random
+// holes, overhangs and empty rows on top, plus some pure noise. They follow only from
+// the seed and their index. Afterwards the standard boards are timed. Desktop only.
+class FeatureCheck
+{
+public:
+	struct Mismatch
+	{
+		uint64_t index;	// Of the board in the run
+		int width;
+		int height;
+		std::array<uint32_t, heuristics::maxHeight> rows;
+		std::string difference;
+	};
+public:
+	// Checks boardCount boards, then times as many extractions. False on a mismatch, see GetMismatch.
+	bool Run(uint64_t boardCount, uint64_t seed);
+	const Mismatch& GetMismatch() const;
+	double GetNanosecondsPerBoard() const;
+private:
+	static void GenerateBoard(uint64_t seed, uint64_t index, Mismatch& board);
+	// Straight from the definitions, one cell at a time
+	static void CountCells(const uint32_t* rows, int width, int height, heuristics::BoardFeatures& features);
+	static bool Compare(const heuristics::BoardFeatures& expected, const heuristics::BoardFeatures& actual, int width, std::string& difference);
+private:
+	Mismatch mismatch;
+	std::vector<uint32_t> standardBoards;	// Rows of the timed boards back to back
+	int featureSum = 0;	// Of the timed extractions, so they can't be optimized away
+	double nanosecondsPerBoard = 0.0;
+};
\ No newline at end of file
@@ -1,37 +1,75 @@
 #include <assert.h>
+#include <algorithm>
 #include "Game.h"
 #include "raylib.h"
 #include "Settings.h"
 #include "GameUtils.h"
 #include "GameState.h"
+#include "AllocationTracker.h"
+#include "Zobrist.h"
+#include <ctime>
+#include <cstdio>
 
-Game::Game(int width, int height, int fps, std::string title)
+Game::Game(int width, int height, int fps, std::string title, const LaunchOptions& options)
 	: board(settings::boardPosition, settings::boardWidthHeight, settings::cellSize, settings::boardPadding),
-	speedLevel(settings::initialDropInterval)
+	particles(settings::maxParticles),
+	simulation(particles, settings::replayPath, options.replayPath.empty() ? settings::replayPath : options.replayPath),
+	leaderboard(settings::leaderboardLogPath, settings::leaderboardIndexPath),
+	targetFrameTime(1.0 / fps),
+	latencyReportPath(options.latencyReportPath),
+	isInjecting(options.injectedInputs > 0),
+	injectedInputsLeft(options.injectedInputs),
+	menuRegions(settings::screenWidth, settings::screenHeight, settings::touchGridCellSize),
+	gameplayRegions(settings::screenWidth, settings::screenHeight, settings::touchGridCellSize),
+	pauseRegions(settings::screenWidth, settings::screenHeight, settings::touchGridCellSize),
+	gameOverRegions(settings::screenWidth, settings::screenHeight, settings::touchGridCellSize),
+	replayRegions(settings::screenWidth, settings::screenHeight, settings::touchGridCellSize)
 {
 	assert(!GetWindowHandle());	// Make sure we don't already have a window
+	if (isInjecting)
+	{
+		// Nobody watches, CI machines may not even have a display to show it on
+		SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	}
+	if (isInjecting || !latencyReportPath.empty())
+	{
+		latency.Enable();
+	}
 	SetTargetFPS(fps);
 	InitWindow(width, height, title.c_str());
 	InitTouchControls();
+
+	leaderboard.Open();
+
+	// Pick up a game that was interrupted by a crash or a closed tab
+	if (simulation.Open(settings::journalPath))
+	{
+		currentState = GameState::Pause;
+	}
+	simulation.Start();
+	if (!options.replayPath.empty())
+	{
+		StartWatching();
+	}
+	lastTickTime = GetTime();
 }
 
 Game::~Game() noexcept
 {
 	assert(GetWindowHandle());	// Already closed?
+	simulation.Stop();
+	if (!latencyReportPath.empty())
+	{
+		latency.WriteReport(latencyReportPath);
+	}
 	CloseWindow();
 }
 
 bool Game::ShouldClose() const
 {
-	return WindowShouldClose() || isGameOver;
-}
-
-void Game::IncreaseDifficulty(float newDropInterval)
-{
-	if (currentTetromino)
-	{
-		currentTetromino->SetDropInterval(newDropInterval);
-	}
+	// An injected run ends once every input it played has been shown
+	const bool isInjectionDone = isInjecting && injectedInputsLeft == 0 && latency.GetPendingCount() == 0;
+	return WindowShouldClose() || isInjectionDone;
 }
 
 void Game::InitTouchControls()
@@ -54,8 +92,9 @@ void Game::InitTouchControls()
 	rotateRightBtn = { screenW - btnWidth * 2 - padding - 10, bottomY, btnWidth, btnHeight };
 	dropBtn = { screenW - btnWidth - padding, bottomY, btnWidth, btnHeight };
 
-	// Pause button - top right corner
+	// Pause button - top right corner, the tap to place toggle below it
 	pauseBtn = { screenW - 60, 10, 50, 50 };
+	placeModeBtn = { screenW - 60, 70, 50, 50 };
 
 	// Menu buttons - centered on screen
 	float menuBtnWidth = 200;
@@ -65,24 +104,189 @@ void Game::InitTouchControls()
 	startBtn = { centerX, screenH / 2 - 30, menuBtnWidth, menuBtnHeight };
 	resumeBtn = { centerX, screenH / 2 - 80, menuBtnWidth, menuBtnHeight };
 	restartBtn = { centerX, screenH / 2, menuBtnWidth, menuBtnHeight };
+	watchBtn = { centerX, screenH / 2 + 80, menuBtnWidth, menuBtnHeight };
+
+	// Replay controls, a seek bar along the bottom and a back button top left
+	replayBar = { padding, screenH - 80, screenW - padding * 2, 24 };
+	backBtn = { 10, 10, 50, 50 };
+	// Hit test grids, one per screen since menu buttons overlap across screens. They
+	// cover the same screen size the buttons were laid out for.
+	const int gridW = static_cast<int>(screenW);
+	const int gridH = static_cast<int>(screenH);
+	menuRegions.Resize(gridW, gridH);
+	gameplayRegions.Resize(gridW, gridH);
+	pauseRegions.Resize(gridW, gridH);
+	gameOverRegions.Resize(gridW, gridH);
+	replayRegions.Resize(gridW, gridH);
+
+	menuRegions.Clear();
+	menuRegions.AddRegion(static_cast<int>(TouchButton::Start), startBtn);
+	menuRegions.Build();
+
+	gameplayRegions.Clear();
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::Left), leftBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::Right), rightBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::RotateLeft), rotateLeftBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::RotateRight), rotateRightBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::Drop), dropBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::Pause), pauseBtn);
+	gameplayRegions.AddRegion(static_cast<int>(TouchButton::PlaceMode), placeModeBtn);
+	gameplayRegions.Build();
+
+	pauseRegions.Clear();
+	pauseRegions.AddRegion(static_cast<int>(TouchButton::Resume), resumeBtn);
+	pauseRegions.AddRegion(static_cast<int>(TouchButton::Restart), restartBtn);
+	pauseRegions.Build();
+
+	gameOverRegions.Clear();
+	gameOverRegions.AddRegion(static_cast<int>(TouchButton::Restart), restartBtn);
+	gameOverRegions.AddRegion(static_cast<int>(TouchButton::Watch), watchBtn);
+	gameOverRegions.Build();
+
+	replayRegions.Clear();
+	replayRegions.AddRegion(static_cast<int>(TouchButton::ReplayBar), replayBar);
+	replayRegions.AddRegion(static_cast<int>(TouchButton::Pause), pauseBtn);
+	replayRegions.AddRegion(static_cast<int>(TouchButton::Back), backBtn);
+	replayRegions.Build();
+}
+
+const TouchRegionGrid& Game::GetActiveTouchRegions() const
+{
+	switch (currentState)
+	{
+	case GameState::Gameplay:
+		return gameplayRegions;
+	case GameState::Pause:
+		return pauseRegions;
+	case GameState::GameOver:
+		return gameOverRegions;
+	case GameState::Replay:
+		return replayRegions;
+	default:
+		return menuRegions;
+	}
 }
 
-bool Game::IsButtonTouched(Rectangle btn)
+bool Game::IsButtonPressed(TouchButton button) const
 {
-	if (GetTouchPointCount() > 0)
+	for (int i = 0; i < gestures.GetEventCount(); ++i)
 	{
-		Vector2 touchPos = GetTouchPosition(0);
-		return CheckCollisionPointRec(touchPos, btn);
+		const GestureEvent& e = gestures.GetEvent(i);
+		if (e.type == GestureType::Press && e.region == static_cast<int>(button))
+			return true;
 	}
 	return false;
 }
 
 void Game::Tick()
 {
-	BeginDrawing();
+	AllocationScope allocationScope(AllocationTag::Render);
+#ifdef TRACK_ALLOCATIONS
+	const AllocationCounts countsBefore = GetAllocationCounts();
+	const GameState stateBefore = currentState;
+#endif
+	const double tickStart = GetTime();
+	// Clamp so a long blocking wait on an idle screen doesn't turn into one huge step
+	frameTime = static_cast<float>(std::min(tickStart - lastTickTime, settings::maxFrameTime));
+	lastTickTime = tickStart;
+
 	Update();
-	Draw();
-	EndDrawing();
+
+	if (NeedsRedraw())
+	{
+		BeginDrawing();
+		Draw();
+		EndDrawing();
+		latency.OnFramePresented(LatencyTracker::Now());
+		MarkDrawn();
+	}
+	else
+	{
+		// Keep the previous frame on screen, only poll input and pace the loop
+		PollInputEvents();
+#ifndef PLATFORM_WEB
+		const double remaining = targetFrameTime - (GetTime() - tickStart);
+		if (remaining > 0.0)
+		{
+			WaitTime(remaining);
+		}
+#endif
+	}
+
+	UpdateEventWaiting();
+#ifdef TRACK_ALLOCATIONS
+	CheckFrameAllocations(countsBefore, stateBefore);
+#endif
+}
+
+#ifdef TRACK_ALLOCATIONS
+void Game::CheckFrameAllocations(const AllocationCounts& countsBefore, GameState stateBefore)
+{
+	frameAllocations = GetAllocationCounts() - countsBefore;
+	// A frame that starts and ends in gameplay is the steady state, it must not touch
+	// the heap on either thread. Starting a game, game over and replays are tagged as
+	// Session and may allocate.
+	if (stateBefore != GameState::Gameplay || currentState != GameState::Gameplay)
+		return;
+	const uint64_t renderCalls = frameAllocations.GetCalls(AllocationTag::Render);
+	const uint64_t simulationCalls = frameAllocations.GetCalls(AllocationTag::Simulation);
+	if (renderCalls == 0 && simulationCalls == 0)
+		return;
+
+	++allocatingFrameCount;
+	// An injected run is the automated check, it reports every offending frame and fails
+	// at exit. Played by hand, stop right at the frame.
+	std::fprintf(stderr, "Gameplay frame allocated: %llu render, %llu simulation calls\n",
+		static_cast<unsigned long long>(renderCalls), static_cast<unsigned long long>(simulationCalls));
+	assert(isInjecting);
+}
+
+void Game::DrawAllocationOverlay() const
+{
+	for (int i = 0; i < AllocationCounts::tagCount; ++i)
+	{
+		const AllocationTag tag = static_cast<AllocationTag>(i);
+		DrawText(TextFormat("%s: %llu (%llu B)", GetAllocationTagName(tag),
+			static_cast<unsigned long long>(frameAllocations.GetCalls(tag)),
+			static_cast<unsigned long long>(frameAllocations.GetBytes(tag))), 10, 70 + i * 18, 16, LIME);
+	}
+}
+#endif
+
+int Game::GetAllocatingFrameCount() const
+{
+#ifdef TRACK_ALLOCATIONS
+	return allocatingFrameCount;
+#else
+	return 0;
+#endif
+}
+
+bool Game::NeedsRedraw() const
+{
+	// The simulation only publishes a frame when something visible changed
+	return needsRedraw || !particles.IsEmpty() || simulation.GetFrame().sequence != drawnFrameSequence;
+}
+
+void Game::MarkDrawn()
+{
+	needsRedraw = false;
+	drawnFrameSequence = simulation.GetFrame().sequence;
+}
+
+void Game::UpdateEventWaiting()
+{
+#ifndef PLATFORM_WEB
+	// Static screens block in the event poll until there is input instead of spinning,
+	// a replay keeps receiving frames from the simulation thread so it never waits
+	const bool isIdle = currentState != GameState::Gameplay && currentState != GameState::Replay &&
+		currentState != GameState::Spectate && !NeedsRedraw();
+	if (isIdle != isEventWaiting)
+	{
+		isIdle ? EnableEventWaiting() : DisableEventWaiting();
+		isEventWaiting = isIdle;
+	}
+#endif
 }
 
 void Game::Draw()
@@ -100,9 +304,27 @@ void Game::Draw()
 	case GameState::Pause:
 		DrawPause();
 		break;
+	case GameState::GameOver:
+		DrawGameOver();
+		break;
+	case GameState::Replay:
+		DrawReplay();
+		break;
+#ifndef PLATFORM_WEB
+	case GameState::Spectate:
+		DrawSpectate();
+		break;
+#endif
 	default:
 		break;
 	}
+
+#ifdef TRACK_ALLOCATIONS
+	if (isAllocationOverlayVisible)
+	{
+		DrawAllocationOverlay();
+	}
+#endif
 }
 
 void Game::DrawMainMenu()
@@ -130,21 +352,43 @@ void Game::DrawMainMenu()
 	DrawText(instructions, (int)(screenW - instrWidth) / 2, (int)(startBtn.y + startBtn.height + 30), 16, GRAY);
 
 	// Keyboard hint (for desktop testing)
-	DrawText("Or press ENTER to start", 10, GetScreenHeight() - 30, 16, DARKGRAY);
+#ifdef PLATFORM_WEB
+	DrawText("Or press ENTER to start, W to watch the last game", 10, GetScreenHeight() - 30, 16, DARKGRAY);
+#else
+	DrawText("Or press ENTER to start, W to watch the last game, S for the spectator wall", 10, GetScreenHeight() - 30, 16, DARKGRAY);
+#endif
 }
 
 void Game::DrawGameplay()
 {
+	const GameSnapshot& snapshot = simulation.GetFrame().snapshot;
+
 	// Game info
-	DrawText(std::to_string(static_cast<int>(elapsedTime)).c_str(), 10, 10, 20, WHITE);
-	DrawText(("Level: " + std::to_string(speedLevel)).c_str(), 10, 35, 20, WHITE);
+	// TextFormat writes into raylib's static ring buffer, so the HUD costs no heap allocations per frame
+	DrawText(TextFormat("%d", snapshot.elapsedTicks / settings::ticksPerSecond), 10, 10, 20, WHITE);
+	DrawText(TextFormat("Level: %d", snapshot.speedLevel), 10, 35, 20, WHITE);
+	const char* scoreText = TextFormat("Score: %d", snapshot.score);
+	DrawText(scoreText, GetScreenWidth() - 70 - MeasureText(scoreText, 20), 10, 20, WHITE);
+	const char* linesText = TextFormat("Lines: %d", snapshot.lines);
+	DrawText(linesText, GetScreenWidth() - 70 - MeasureText(linesText, 20), 35, 20, WHITE);
 
 	// Draw board and current piece
 	board.Draw();
+#ifndef PLATFORM_WEB
+	if (isHintVisible && hasHint && currentTetromino)
+	{
+		DrawGhost(hint.placement, 0.2f);
+	}
+#endif
+	if (isPlacing && hasGhost && currentTetromino)
+	{
+		DrawGhost(ghost, 0.35f);
+	}
 	if (currentTetromino)
 	{
 		currentTetromino->Draw();
 	}
+	particles.Draw();
 
 	// Draw touch controls
 	DrawTouchControls();
@@ -184,6 +428,27 @@ void Game::DrawTouchControls()
 	DrawRectangleRec(pauseBtn, btnColor);
 	DrawRectangleLinesEx(pauseBtn, 2, btnBorder);
 	DrawText("||", (int)(pauseBtn.x + 15), (int)(pauseBtn.y + 12), 25, WHITE);
+
+	// Tap to place toggle, lit while the mode is on
+	DrawRectangleRec(placeModeBtn, isPlaceMode ? Fade(DARKGREEN, 0.8f) : btnColor);
+	DrawRectangleLinesEx(placeModeBtn, 2, btnBorder);
+	DrawText("TAP", (int)(placeModeBtn.x + 7), (int)(placeModeBtn.y + 17), 16, WHITE);
+}
+
+void Game::DrawGhost(const PathPlanner::Placement& placement, float alpha) const
+{
+	const pieces::Footprint& footprint = pieces::GetFootprint(currentTetromino->GetType(), placement.rotation);
+	const Color color = Fade(currentTetromino->GetColor(), alpha);
+	for (int y = footprint.minY; y <= footprint.maxY; ++y)
+	{
+		for (int x = footprint.minX; x <= footprint.maxX; ++x)
+		{
+			if ((footprint.rows[y] >> x) & 1u)
+			{
+				board.DrawCell({ placement.x + x, placement.y + y }, color);
+			}
+		}
+	}
 }
 
 void Game::DrawPause()
@@ -219,19 +484,131 @@ void Game::DrawPause()
 	DrawText("P - Resume | R - Restart", 10, GetScreenHeight() - 30, 16, DARKGRAY);
 }
 
-void Game::Update()
+void Game::DrawGameOver()
+{
+	float screenW = static_cast<float>(GetScreenWidth());
+
+	// Final board with the top-out burst behind the results
+	board.Draw();
+	particles.Draw();
+	DrawRectangle(0, 0, GetScreenWidth(), GetScreenHeight(), Fade(BLACK, 0.6f));
+
+	const char* title = "GAME OVER";
+	int titleWidth = MeasureText(title, 50);
+	DrawText(title, (int)(screenW - titleWidth) / 2, 60, 50, WHITE);
+
+	const GameSnapshot& snapshot = simulation.GetFrame().snapshot;
+	const char* result = TextFormat("Score %d   Lines %d", snapshot.score, snapshot.lines);
+	int resultWidth = MeasureText(result, 20);
+	DrawText(result, (int)(screenW - resultWidth) / 2, 120, 20, WHITE);
+
+	// High scores
+	for (int i = 0; i < topScoreCount; ++i)
+	{
+		const LeaderboardEntry& entry = topScores[i];
+		const char* line = TextFormat("%d.  %d  L%d", i + 1, entry.score, entry.level);
+		int lineWidth = MeasureText(line, 20);
+		DrawText(line, (int)(screenW - lineWidth) / 2, 160 + i * 26, 20, GOLD);
+	}
+
+	// Play again button
+	DrawRectangleRec(restartBtn, DARKGRAY);
+	DrawRectangleLinesEx(restartBtn, 3, WHITE);
+	const char* restartText = "PLAY AGAIN";
+	int restartTextWidth = MeasureText(restartText, 24);
+	DrawText(restartText,
+		(int)(restartBtn.x + (restartBtn.width - restartTextWidth) / 2),
+		(int)(restartBtn.y + (restartBtn.height - 24) / 2),
+		24, WHITE);
+
+	// Watch replay button
+	DrawRectangleRec(watchBtn, DARKGRAY);
+	DrawRectangleLinesEx(watchBtn, 3, WHITE);
+	const char* watchText = "WATCH REPLAY";
+	int watchTextWidth = MeasureText(watchText, 24);
+	DrawText(watchText,
+		(int)(watchBtn.x + (watchBtn.width - watchTextWidth) / 2),
+		(int)(watchBtn.y + (watchBtn.height - 24) / 2),
+		24, WHITE);
+
+	// Keyboard hints
+	DrawText("ENTER - Play again | W - Watch replay", 10, GetScreenHeight() - 30, 16, DARKGRAY);
+}
+
+void Game::DrawReplay()
 {
-	// Update touch cooldown
-	if (touchCooldown > 0)
+	const Simulation::Frame& frame = simulation.GetFrame();
+	float screenW = static_cast<float>(GetScreenWidth());
+
+	if (!frame.isWatching)
 	{
-		touchCooldown -= GetFrameTime();
+		// Only once the simulation has answered the request
+		if (frame.sequence != watchRequestSequence)
+		{
+			const char* text = "NO REPLAY TO WATCH";
+			int textWidth = MeasureText(text, 30);
+			DrawText(text, (int)(screenW - textWidth) / 2, GetScreenHeight() / 2 - 15, 30, WHITE);
+		}
+	}
+	else
+	{
+		board.Draw();
+		if (currentTetromino)
+		{
+			currentTetromino->Draw();
+		}
+		particles.Draw();
+
+		// Position in the recording
+		const int seconds = frame.snapshot.elapsedTicks / settings::ticksPerSecond;
+		const int totalSeconds = frame.replayLastTick / settings::ticksPerSecond;
+		const char* timeText = TextFormat("%d:%02d / %d:%02d", seconds / 60, seconds % 60, totalSeconds / 60, totalSeconds % 60);
+		DrawText(timeText, (int)(screenW - MeasureText(timeText, 20)) / 2, (int)replayBar.y - 30, 20, WHITE);
+
+		const float progress = frame.replayLastTick > 0 ? static_cast<float>(frame.snapshot.elapsedTicks) / frame.replayLastTick : 1.0f;
+		DrawRectangleRec(replayBar, DARKGRAY);
+		DrawRectangleRec({ replayBar.x, replayBar.y, replayBar.width * progress, replayBar.height }, frame.isRunning ? SKYBLUE : GRAY);
+		DrawRectangleLinesEx(replayBar, 2, WHITE);
+
+		// Play/pause toggle
+		DrawRectangleRec(pauseBtn, Fade(DARKGRAY, 0.7f));
+		DrawRectangleLinesEx(pauseBtn, 2, Fade(WHITE, 0.5f));
+		DrawText(frame.isRunning ? "||" : ">", (int)(pauseBtn.x + 15), (int)(pauseBtn.y + 12), 25, WHITE);
 	}
 
-	// Reset touch state when no longer touching
-	if (GetTouchPointCount() == 0)
+	// Back button
+	DrawRectangleRec(backBtn, Fade(DARKGRAY, 0.7f));
+	DrawRectangleLinesEx(backBtn, 2, Fade(WHITE, 0.5f));
+	DrawText("<", (int)(backBtn.x + 17), (int)(backBtn.y + 12), 25, WHITE);
+
+	// Keyboard hints
+	DrawText("SPACE - Play/Pause | LEFT/RIGHT - 5s | DOWN/UP - 60s | ENTER - Menu", 10, GetScreenHeight() - 30, 16, DARKGRAY);
+}
+
+void Game::Update()
+{
+	// Lay the buttons out again for the new size before hit testing against them
+	if (IsWindowResized())
+	{
+		AllocationScope resizeScope(AllocationTag::Session);
+		InitTouchControls();
+	}
+	// Buttons react on touch down, in the same frame the touch is seen
+	gestures.Update(GetActiveTouchRegions(), GetTime());
+	inputReadTime = LatencyTracker::Now();
+	if (isInjecting)
+	{
+		InjectInput();
+	}
+	const GameState previousState = currentState;
+	particles.Update(frameTime);
+#ifdef TRACK_ALLOCATIONS
+	if (IsKeyPressed(KEY_F3))
 	{
-		isTouching = false;
+		isAllocationOverlayVisible = !isAllocationOverlayVisible;
+		needsRedraw = true;
 	}
+#endif
 
 	switch (currentState)
 	{
@@ -244,29 +621,71 @@ void Game::Update()
 	case GameState::Pause:
 		UpdatePause();
 		break;
+	case GameState::GameOver:
+		UpdateGameOver();
+		break;
+	case GameState::Replay:
+		UpdateReplay();
+		break;
+#ifndef PLATFORM_WEB
+	case GameState::Spectate:
+		UpdateSpectate();
+		break;
+#endif
 	default:
 		break;
 	}
+
+#ifdef PLATFORM_WEB
+	// No threads in the browser, the simulation runs its ticks inline
+	simulation.Update(frameTime);
+#endif
+	if (simulation.FetchFrame())
+	{
+		const Simulation::Frame& frame = simulation.GetFrame();
+		latency.OnFrameFetched(frame.commandsConsumed, frame.consumedTime);
+		ApplyFrame();
+	}
+	if (currentState != GameState::Gameplay)
+	{
+		isPlacing = false;
+	}
+#ifndef PLATFORM_WEB
+	UpdateHint();
+#endif
+
+	if (currentState != previousState || gestures.GetEventCount() > 0 || IsWindowResized())
+	{
+		needsRedraw = true;
+	}
 }
 
 void Game::UpdateMainMenu()
 {
 	// Touch input - start game
-	if (!isTouching && IsButtonTouched(startBtn))
+	if (IsButtonPressed(TouchButton::Start))
 	{
-		currentState = GameState::Gameplay;
-		isTouching = true;
+		StartNewGame();
 	}
 
 	// Keyboard input (for desktop testing)
 	if (IsKeyPressed(KEY_ENTER))
 	{
-		currentState = GameState::Gameplay;
+		StartNewGame();
+	}
+	else if (IsKeyPressed(KEY_W))
+	{
+		StartWatching();
 	}
 #ifndef PLATFORM_WEB
+	else if (IsKeyPressed(KEY_S))
+	{
+		StartSpectating();
+	}
 	else if (IsKeyPressed(KEY_F))
 	{
 		ToggleFullscreen();
+		needsRedraw = true;
 	}
 	else if (IsKeyPressed(KEY_ESCAPE))
 	{
@@ -277,104 +696,264 @@ void Game::UpdateMainMenu()
 
 void Game::HandleGameplayTouchInput()
 {
-	if (!currentTetromino || isTouching || touchCooldown > 0) return;
-
-	if (IsButtonTouched(leftBtn))
-	{
-		currentTetromino->MoveLeft();
-		isTouching = true;
-		touchCooldown = TOUCH_COOLDOWN_TIME;
-	}
-	else if (IsButtonTouched(rightBtn))
-	{
-		currentTetromino->MoveRight();
-		isTouching = true;
-		touchCooldown = TOUCH_COOLDOWN_TIME;
-	}
-	else if (IsButtonTouched(rotateLeftBtn))
-	{
-		currentTetromino->RotateCounterClockwise();
-		isTouching = true;
-		touchCooldown = TOUCH_COOLDOWN_TIME;
-	}
-	else if (IsButtonTouched(rotateRightBtn))
+	for (int i = 0; i < gestures.GetEventCount(); ++i)
 	{
-		currentTetromino->RotateClockwise();
-		isTouching = true;
-		touchCooldown = TOUCH_COOLDOWN_TIME;
-	}
-	else if (IsButtonTouched(dropBtn))
-	{
-		currentTetromino->Drop();
-		isTouching = true;
-		touchCooldown = TOUCH_COOLDOWN_TIME;
+		const GestureEvent& e = gestures.GetEvent(i);
+
+		// Gestures that start on the playfield rather than on a button
+		if (e.region == TouchRegionGrid::noRegion)
+		{
+			if (isPlaceMode)
+			{
+				HandlePlacementGesture(e);
+				continue;
+			}
+			switch (e.type)
+			{
+			case GestureType::SwipeLeft:
+				PostInput(Simulation::Command::MoveLeft, InputKind::Swipe);
+				break;
+			case GestureType::SwipeRight:
+				PostInput(Simulation::Command::MoveRight, InputKind::Swipe);
+				break;
+			case GestureType::SwipeDown:
+				PostInput(Simulation::Command::Drop, InputKind::Swipe);
+				break;
+			case GestureType::SwipeUp:
+				PostInput(Simulation::Command::RotateClockwise, InputKind::Swipe);
+				break;
+			case GestureType::Tap:
+				PostInput(Simulation::Command::RotateClockwise, InputKind::Tap);
+				break;
+			default:
+				break;
+			}
+			continue;
+		}
+
+		const TouchButton button = static_cast<TouchButton>(e.region);
+		if (e.type == GestureType::LongPress)
+		{
+			// Holding a move button slides the piece all the way to the wall
+			for (int n = 0; n < settings::boardWidthHeight.GetX(); ++n)
+			{
+				if (button == TouchButton::Left) simulation.Post(Simulation::Command::MoveLeft);
+				else if (button == TouchButton::Right) simulation.Post(Simulation::Command::MoveRight);
+			}
+			if (button == TouchButton::Left || button == TouchButton::Right)
+			{
+				// Done when the piece is shown at the wall
+				latency.OnInputRead(InputKind::LongPress, simulation.GetPostedCount(), inputReadTime);
+			}
+			continue;
+		}
+		if (e.type != GestureType::Press)
+			continue;
+
+		switch (button)
+		{
+		case TouchButton::Left:
+			PostInput(Simulation::Command::MoveLeft, InputKind::Button);
+			break;
+		case TouchButton::Right:
+			PostInput(Simulation::Command::MoveRight, InputKind::Button);
+			break;
+		case TouchButton::RotateLeft:
+			PostInput(Simulation::Command::RotateCounterClockwise, InputKind::Button);
+			break;
+		case TouchButton::RotateRight:
+			PostInput(Simulation::Command::RotateClockwise, InputKind::Button);
+			break;
+		case TouchButton::Drop:
+			PostInput(Simulation::Command::Drop, InputKind::Button);
+			break;
+		case TouchButton::PlaceMode:
+			isPlaceMode = !isPlaceMode;
+			isPlacing = false;
+			break;
+		case TouchButton::Pause:
+			PostInput(Simulation::Command::Pause, InputKind::Button);
+			currentState = GameState::Pause;
+			return;
+		default:
+			break;
+		}
 	}
-	else if (IsButtonTouched(pauseBtn))
+}
+
+void Game::PostInput(Simulation::Command command, InputKind kind)
+{
+	if (simulation.Post(command))
 	{
-		currentState = GameState::Pause;
-		isTouching = true;
+		latency.OnInputRead(kind, simulation.GetPostedCount(), inputReadTime);
 	}
 }
 
-void Game::UpdateGameplay()
+void Game::InjectInput()
 {
-	if (board.IsTopRowOccupied()) {
-		isGameOver = true;
-	}
+	// A fast player's input on the touch controls, one every few frames
+	if (++injectFrame % settings::latencyInjectInterval != 0)
+		return;
 
-	float deltaTime = GetFrameTime();
-	elapsedTime += deltaTime;
+	struct InjectedGesture
+	{
+		GestureType type;
+		int region;
+		Vec2<int> cell = { 4, 10 };	// Board cell the touch is on, for tap to place
+	};
+	static constexpr InjectedGesture script[] = {
+		{ GestureType::Press, static_cast<int>(TouchButton::Left) },
+		{ GestureType::Press, static_cast<int>(TouchButton::RotateRight) },
+		{ GestureType::SwipeRight, TouchRegionGrid::noRegion },
+		{ GestureType::Tap, TouchRegionGrid::noRegion },
+		{ GestureType::Press, TouchRegionGrid::noRegion, { 1, 17 } },
+		{ GestureType::Move, TouchRegionGrid::noRegion, { 2, 19 } },
+		{ GestureType::Release, TouchRegionGrid::noRegion, { 2, 19 } },
+		{ GestureType::Press, static_cast<int>(TouchButton::Right) },
+		{ GestureType::LongPress, static_cast<int>(TouchButton::Left) },
+		{ GestureType::Press, static_cast<int>(TouchButton::RotateLeft) },
+		{ GestureType::SwipeLeft, TouchRegionGrid::noRegion },
+		{ GestureType::Press, static_cast<int>(TouchButton::Drop) },
+		{ GestureType::Press, TouchRegionGrid::noRegion, { 8, 16 } },
+		{ GestureType::Move, TouchRegionGrid::noRegion, { 7, 18 } },
+		{ GestureType::Release, TouchRegionGrid::noRegion, { 7, 19 } },
+		{ GestureType::SwipeDown, TouchRegionGrid::noRegion },
+		{ GestureType::LongPress, static_cast<int>(TouchButton::Right) },
+		{ GestureType::SwipeUp, TouchRegionGrid::noRegion }
+	};
+	constexpr int scriptLength = static_cast<int>(sizeof(script) / sizeof(script[0]));
+
+	// Menus are clicked through the same way, the game restarts until all inputs are played
+	const Vector2 pos = { settings::screenWidth / 2.0f, settings::screenHeight / 2.0f };
+	switch (currentState)
+	{
+	case GameState::MainMenu:
+		gestures.Inject(GestureType::Press, static_cast<int>(TouchButton::Start), pos);
+		break;
+	case GameState::Pause:
+		gestures.Inject(GestureType::Press, static_cast<int>(TouchButton::Resume), pos);
+		break;
+	case GameState::GameOver:
+		gestures.Inject(GestureType::Press, static_cast<int>(TouchButton::Restart), pos);
+		break;
+	case GameState::Gameplay:
+		if (injectedInputsLeft > 0)
+		{
+			// Played front to back, a placement drag needs its press, moves and release in order
+			const InjectedGesture& gesture = script[scriptLength - 1 - injectedInputsLeft % scriptLength];
+			const Vec2<int> center = settings::boardPosition + settings::boardPadding + gesture.cell * settings::cellSize + settings::cellSize / 2;
+			const Vector2 cellPos = { static_cast<float>(center.GetX()), static_cast<float>(center.GetY()) };
 
-	// Increase speed level every 60 seconds
-	if (elapsedTime >= settings::timeIntervalSpeedUp * speedLevel) {
-		speedLevel++;
-		if (currentTetromino) {
-			currentTetromino->SetDropInterval(std::max(0.1f, 1.0f - 0.1f * (speedLevel - 1)));
+			// Playfield touches drag a placement in place mode and swipe otherwise. The mode
+			// button is pressed first whenever the next one needs the other mode, so a drag
+			// cut short by a game over can't leave the wrong mode on.
+			const bool isPlayfield = gesture.region == TouchRegionGrid::noRegion;
+			const bool isPlacement = isPlayfield &&
+				(gesture.type == GestureType::Press || gesture.type == GestureType::Move || gesture.type == GestureType::Release);
+			if (isPlayfield && isPlacement != isPlaceMode)
+			{
+				gestures.Inject(GestureType::Press, static_cast<int>(TouchButton::PlaceMode), pos);
+			}
+			gestures.Inject(gesture.type, gesture.region, isPlacement ? cellPos : pos);
+			--injectedInputsLeft;
 		}
+		break;
+	default:
+		break;
 	}
+}
 
-	if (!currentTetromino || currentTetromino->HasLanded()) {
-		if (currentTetromino)
+void Game::HandlePlacementGesture(const GestureEvent& e)
+{
+	switch (e.type)
+	{
+	case GestureType::Press:
+	case GestureType::Move:
+		// The ghost follows the finger, the piece only moves on release
+		isPlacing = true;
+		placeCell = board.ScreenToCell(e.pos);
+		UpdatePlacementGhost();
+		break;
+	case GestureType::Release:
+		if (isPlacing && hasGhost && simulation.PostPlace(placeCell.GetX(), placeCell.GetY()))
 		{
-			currentTetromino->AddToBoard();
+			latency.OnInputRead(InputKind::Place, simulation.GetPostedCount(), inputReadTime);
 		}
-		currentTetromino = GenerateRandomTetromino(board);
+		isPlacing = false;
+		break;
+	default:
+		break;
+	}
+}
+
+void Game::UpdatePlacementGhost()
+{
+	hasGhost = false;
+	if (!currentTetromino)
+		return;
+
+	// Planned on the render side copy just for the preview, the simulation plans
+	// again on its own state when the placement is posted
+	std::array<uint32_t, PathPlanner::maxHeight> rows;
+	for (int y = 0; y < board.GetHeight(); ++y)
+	{
+		rows[y] = board.GetRowMask(y);
 	}
+	const Tetromino::State state = currentTetromino->GetState();
+	const PathPlanner::Placement start = { state.pos.GetX(), state.pos.GetY(), static_cast<int>(state.rotation) / 90 };
+	hasGhost = planner.Plan(rows.data(), board.GetWidth(), board.GetHeight(), currentTetromino->GetType(), start,
+		placeCell.GetX(), placeCell.GetY());
+	ghost = planner.GetTarget();
+}
 
+void Game::UpdateGameplay()
+{
 	// Handle touch input
 	HandleGameplayTouchInput();
 
 	// Keyboard input (for desktop testing)
 	if (IsKeyPressed(KEY_RIGHT))
 	{
-		currentTetromino->MoveRight();
+		PostInput(Simulation::Command::MoveRight, InputKind::Key);
 	}
 	else if (IsKeyPressed(KEY_LEFT))
 	{
-		currentTetromino->MoveLeft();
+		PostInput(Simulation::Command::MoveLeft, InputKind::Key);
 	}
 	else if (IsKeyPressed(KEY_DOWN))
 	{
-		currentTetromino->RotateClockwise();
+		PostInput(Simulation::Command::RotateClockwise, InputKind::Key);
 	}
 	else if (IsKeyPressed(KEY_UP))
 	{
-		currentTetromino->RotateCounterClockwise();
+		PostInput(Simulation::Command::RotateCounterClockwise, InputKind::Key);
 	}
 	else if (IsKeyPressed(KEY_SPACE))
 	{
-		currentTetromino->Drop();
+		PostInput(Simulation::Command::Drop, InputKind::Key);
 	}
 	else if (IsKeyPressed(KEY_R))
 	{
-		board.Reset();
-		currentTetromino->Reset();
+		PostInput(Simulation::Command::ResetBoard, InputKind::Key);
+		particles.Clear();
 	}
 	else if (IsKeyPressed(KEY_P))
 	{
+		PostInput(Simulation::Command::Pause, InputKind::Key);
 		currentState = GameState::Pause;
 	}
+	else if (IsKeyPressed(KEY_T))
+	{
+		// Tap to place with the mouse
+		isPlaceMode = !isPlaceMode;
+		isPlacing = false;
+		needsRedraw = true;
+	}
 #ifndef PLATFORM_WEB
+	else if (IsKeyPressed(KEY_H))
+	{
+		ToggleHint();
+	}
 	else if (IsKeyPressed(KEY_ESCAPE))
 	{
 		CloseWindow();
@@ -382,55 +961,275 @@ void Game::UpdateGameplay()
 	else if (IsKeyPressed(KEY_F))
 	{
 		ToggleFullscreen();
+		needsRedraw = true;
 	}
 #endif
+}
+
+void Game::ApplyFrame()
+{
+	const Simulation::Frame& frame = simulation.GetFrame();
+	const GameSnapshot& snapshot = frame.snapshot;
+	if (!frame.hasGame)
+		return;
+
+	RestoreBoard(snapshot, board);
+	const PieceType type = static_cast<PieceType>(snapshot.pieceType);
+	if (!currentTetromino || currentTetromino->GetType() != type)
+	{
+		currentTetromino.emplace(type, board);
+	}
+	currentTetromino->SetState({ { snapshot.pieceX, snapshot.pieceY },
+		static_cast<Tetromino::Rotation>(snapshot.pieceRotation), snapshot.gravityAccumulator });
+	if (isPlacing)
+	{
+		// The piece fell or was replaced, the ghost is planned from where it is now
+		UpdatePlacementGhost();
+	}
+
+	if (frame.isGameOver && frame.gameId != finishedGameId)
+	{
+		EndGame();
+	}
+}
+
+void Game::EndGame()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	const Simulation::Frame& frame = simulation.GetFrame();
+	const GameSnapshot& snapshot = frame.snapshot;
+	leaderboard.Add({ snapshot.seed, static_cast<int64_t>(std::time(nullptr)), snapshot.score, snapshot.lines, snapshot.speedLevel, snapshot.elapsedTicks });
+	topScoreCount = leaderboard.GetTop(topScores.data(), maxTopScores);
 
-	currentTetromino->Update(deltaTime);
-	board.Update();
+	finishedGameId = frame.gameId;
+	currentState = GameState::GameOver;
+}
+
+void Game::StartNewGame()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	particles.Clear();
+	simulation.Post(Simulation::Command::NewGame);
+	currentState = GameState::Gameplay;
+}
+
+void Game::StartWatching()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	particles.Clear();
+	watchRequestSequence = simulation.GetFrame().sequence;
+	simulation.Post(Simulation::Command::WatchReplay);
+	currentState = GameState::Replay;
+}
+
+#ifndef PLATFORM_WEB
+void Game::StartSpectating()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	spectatorWall.emplace(settings::spectatorBoards, GetScreenWidth(), GetScreenHeight());
+	currentState = GameState::Spectate;
+}
+
+void Game::UpdateSpectate()
+{
+	if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_S))
+	{
+		AllocationScope allocationScope(AllocationTag::Session);
+		spectatorWall.reset();
+		currentState = GameState::MainMenu;
+		return;
+	}
+	if (spectatorWall->Update(frameTime))
+	{
+		needsRedraw = true;
+	}
+}
+
+void Game::ToggleHint()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	if (!hintEngine)
+	{
+		hintEngine.emplace();
+	}
+	isHintVisible = !isHintVisible;
+	needsRedraw = true;
 }
 
+void Game::UpdateHint()
+{
+	if (!isHintVisible || currentState != GameState::Gameplay || !currentTetromino)
+		return;
+
+	// Moving the piece keeps the hint, a lock, a new piece or any change to the board
+	// asks for a new one and cancels the search for the old one
+	const GameSnapshot& snapshot = simulation.GetFrame().snapshot;
+	uint64_t key = zobrist::SequenceKey(snapshot.randomizerState) ^ zobrist::PieceKey(currentTetromino->GetType(), 0, 0, 0);
+	for (int y = 0; y < GameSnapshot::height; ++y)
+	{
+		key ^= zobrist::RowKey(y, snapshot.rowMasks[y]);
+	}
+	if (key != hintKey)
+	{
+		hintKey = key;
+		hasHint = false;
+		needsRedraw = true;
+		const PathPlanner::Placement start = { snapshot.pieceX, snapshot.pieceY, snapshot.pieceRotation / 90 };
+		PieceRandomizer preview;
+		preview.SetState(snapshot.randomizerState);
+		hintEngine->Request(key, snapshot.rowMasks, GameSnapshot::width, GameSnapshot::height, currentTetromino->GetType(), preview.Next(), start);
+	}
+
+	HintEngine::Hint latest;
+	if (hintEngine->FetchHint(hintKey, latest))
+	{
+		hint = latest;
+		hasHint = true;
+		needsRedraw = true;
+	}
+}
+
+void Game::DrawSpectate()
+{
+	spectatorWall->Draw();
+	DrawText(TextFormat("%d games   %llu top outs   %d fps", spectatorWall->GetCount(),
+		static_cast<unsigned long long>(spectatorWall->GetTopOuts()), GetFPS()), 10, 6, 20, WHITE);
+	const char* hint = "S / ENTER - Menu";
+	DrawText(hint, GetScreenWidth() - MeasureText(hint, 16) - 10, 8, 16, DARKGRAY);
+}
+#endif
+
 void Game::UpdatePause()
 {
 	// Touch input
-	if (!isTouching)
+	if (IsButtonPressed(TouchButton::Resume))
 	{
-		if (IsButtonTouched(resumeBtn))
-		{
-			currentState = GameState::Gameplay;
-			isTouching = true;
-		}
-		else if (IsButtonTouched(restartBtn))
-		{
-			board.Reset();
-			if (currentTetromino) currentTetromino->Reset();
-			elapsedTime = 0.0f;
-			speedLevel = settings::initialDropInterval;
-			currentState = GameState::Gameplay;
-			isTouching = true;
-		}
+		simulation.Post(Simulation::Command::Resume);
+		currentState = GameState::Gameplay;
+	}
+	else if (IsButtonPressed(TouchButton::Restart))
+	{
+		StartNewGame();
 	}
 
 	// Keyboard input (for desktop testing)
 	if (IsKeyPressed(KEY_P))
 	{
+		simulation.Post(Simulation::Command::Resume);
 		currentState = GameState::Gameplay;
 	}
 	else if (IsKeyPressed(KEY_R))
 	{
-		board.Reset();
-		if (currentTetromino) currentTetromino->Reset();
-		elapsedTime = 0.0f;
-		speedLevel = settings::initialDropInterval;
-		currentState = GameState::Gameplay;
+		StartNewGame();
 	}
 #ifndef PLATFORM_WEB
 	else if (IsKeyPressed(KEY_F))
 	{
 		ToggleFullscreen();
+		needsRedraw = true;
 	}
 	else if (IsKeyPressed(KEY_ESCAPE))
 	{
 		CloseWindow();
 	}
 #endif
-}
\ No newline at end of file
+}
+
+void Game::UpdateGameOver()
+{
+	// Touch input
+	if (IsButtonPressed(TouchButton::Restart))
+	{
+		StartNewGame();
+	}
+	else if (IsButtonPressed(TouchButton::Watch))
+	{
+		StartWatching();
+	}
+
+	// Keyboard input (for desktop testing)
+	if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_R))
+	{
+		StartNewGame();
+	}
+	else if (IsKeyPressed(KEY_W))
+	{
+		StartWatching();
+	}
+#ifndef PLATFORM_WEB
+	else if (IsKeyPressed(KEY_F))
+	{
+		ToggleFullscreen();
+		needsRedraw = true;
+	}
+	else if (IsKeyPressed(KEY_ESCAPE))
+	{
+		CloseWindow();
+	}
+#endif
+}
+
+void Game::UpdateReplay()
+{
+	const Simulation::Frame& frame = simulation.GetFrame();
+	const int32_t tick = frame.snapshot.elapsedTicks;
+
+	// Touch input, tapping the bar jumps to that point of the recording
+	for (int i = 0; i < gestures.GetEventCount(); ++i)
+	{
+		const GestureEvent& e = gestures.GetEvent(i);
+		if (e.type == GestureType::Press && e.region == static_cast<int>(TouchButton::ReplayBar) && frame.isWatching)
+		{
+			const float position = (e.pos.x - replayBar.x) / replayBar.width;
+			simulation.PostSeek(static_cast<int32_t>(position * frame.replayLastTick));
+		}
+	}
+	if (IsButtonPressed(TouchButton::Back))
+	{
+		simulation.Post(Simulation::Command::Pause);
+		currentState = GameState::MainMenu;
+		return;
+	}
+	if (IsButtonPressed(TouchButton::Pause))
+	{
+		simulation.Post(frame.isRunning ? Simulation::Command::Pause : Simulation::Command::Resume);
+	}
+
+	// Keyboard input (for desktop testing)
+	if (IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_P))
+	{
+		simulation.Post(frame.isRunning ? Simulation::Command::Pause : Simulation::Command::Resume);
+	}
+	else if (IsKeyPressed(KEY_LEFT))
+	{
+		simulation.PostSeek(tick - settings::replaySeekShortTicks);
+	}
+	else if (IsKeyPressed(KEY_RIGHT))
+	{
+		simulation.PostSeek(tick + settings::replaySeekShortTicks);
+	}
+	else if (IsKeyPressed(KEY_DOWN))
+	{
+		simulation.PostSeek(tick - settings::replaySeekLongTicks);
+	}
+	else if (IsKeyPressed(KEY_UP))
+	{
+		simulation.PostSeek(tick + settings::replaySeekLongTicks);
+	}
+	else if (IsKeyPressed(KEY_ENTER))
+	{
+		simulation.Post(Simulation::Command::Pause);
+		currentState = GameState::MainMenu;
+	}
+#ifndef PLATFORM_WEB
+	else if (IsKeyPressed(KEY_F))
+	{
+		ToggleFullscreen();
+		needsRedraw = true;
+	}
+	else if (IsKeyPressed(KEY_ESCAPE))
+	{
+		CloseWindow();
+	}
+#endif
+}
@@ -1,49 +1,147 @@
 #pragma once
 #include <string>
-#include <memory>
+#include <optional>
+#include <array>
 #include "Board.h"
 #include "Tetromino.h"
 #include "GameState.h"
+#include "ParticleSystem.h"
+#include "Gestures.h"
+#include "GameUtils.h"
+#include "GameSnapshot.h"
+#include "Simulation.h"
+#include "Leaderboard.h"
+#include "AllocationTracker.h"
+#include "PathPlanner.h"
+#include "LatencyTracker.h"
+#ifndef PLATFORM_WEB
+#include "SpectatorWall.h"
+#include "HintEngine.h"
+#endif
+
+// From the command line
+struct LaunchOptions
+{
+	std::string replayPath;	// Opens that recording for playback instead of the menu
+	std::string latencyReportPath;	// Measures input latency and writes the report here on exit
+	int injectedInputs = 0;	// Plays this many synthetic touch inputs in a hidden window, then closes
+};
 
 class Game
 {
 public:
-	Game(int width, int height, int fps, std::string title);
+	Game(int width, int height, int fps, std::string title, const LaunchOptions& options);
 	Game(const Game&) = delete;
 	Game& operator=(const Game&) = delete;
 	~Game() noexcept;
 
 	bool ShouldClose() const;
-
-	void IncreaseDifficulty(float newDropInterval);
+	// Steady state gameplay frames that touched the heap, always zero without TRACK_ALLOCATIONS
+	int GetAllocatingFrameCount() const;
 
 	void Tick();
 private:
 	void Draw();
+	bool NeedsRedraw() const;
+	void MarkDrawn();
+	void UpdateEventWaiting();
 	void DrawMainMenu();
 	void DrawGameplay();
 	void DrawPause();
+	void DrawGameOver();
+	void DrawReplay();
 	void Update();
 	void UpdateMainMenu();
 	void UpdateGameplay();
 	void UpdatePause();
+	void UpdateGameOver();
+	void UpdateReplay();
+	void ApplyFrame();
+	void EndGame();
+	void StartNewGame();
+	void StartWatching();
+	void PostInput(Simulation::Command command, InputKind kind);
+	void InjectInput();
+	void HandlePlacementGesture(const GestureEvent& e);
+	void UpdatePlacementGhost();
+	void DrawGhost(const PathPlanner::Placement& placement, float alpha) const;
+#ifndef PLATFORM_WEB
+	void StartSpectating();
+	void UpdateSpectate();
+	void DrawSpectate();
+	void ToggleHint();
+	void UpdateHint();
+#endif
+#ifdef TRACK_ALLOCATIONS
+	void CheckFrameAllocations(const AllocationCounts& countsBefore, GameState stateBefore);
+	void DrawAllocationOverlay() const;
+#endif
+
+	enum class TouchButton
+	{
+		Left,
+		Right,
+		RotateLeft,
+		RotateRight,
+		Drop,
+		Pause,
+		Start,
+		Resume,
+		Restart,
+		Watch,
+		ReplayBar,
+		Back,
+		PlaceMode
+	};
 
 	void HandleGameplayTouchInput();
 	void DrawTouchControls();
 	void InitTouchControls();
-	bool IsButtonTouched(Rectangle btn);
+	const TouchRegionGrid& GetActiveTouchRegions() const;
+	bool IsButtonPressed(TouchButton button) const;
 
+	// The render side copy of the game, rebuilt from the latest simulation frame
 	Board board;
-	bool isGameOver = false;
-	float elapsedTime = 0.0f;
-	int speedLevel;
+	ParticleSystem particles;
+	Simulation simulation;
 	GameState currentState = GameState::MainMenu;
+	uint32_t finishedGameId = 0;
+	uint32_t watchRequestSequence = 0;
+
+	Leaderboard leaderboard;
+	static constexpr int maxTopScores = 5;
+	std::array<LeaderboardEntry, maxTopScores> topScores;
+	int topScoreCount = 0;
+
+	// Frame scheduling, frames where nothing visible changed are not redrawn
+	const double targetFrameTime;
+	double lastTickTime = 0.0;
+	float frameTime = 0.0f;
+	bool needsRedraw = true;
+	bool isEventWaiting = false;
+	uint32_t drawnFrameSequence = 0;
 
-	Vector2 touchStartPos;
-	bool isTouching = false;
-	float touchCooldown = 0.0f;
-	const float TOUCH_COOLDOWN_TIME = 0.15f; // Prevent rapid repeated inputs
-	float touchStartTime = 0.0f;
+#ifdef TRACK_ALLOCATIONS
+	// F3 shows the previous frame's allocations per subsystem
+	AllocationCounts frameAllocations;
+	bool isAllocationOverlayVisible = false;
+	int allocatingFrameCount = 0;
+#endif
+
+	// Input latency measurement, see LatencyTracker
+	LatencyTracker latency;
+	std::string latencyReportPath;
+	int64_t inputReadTime = 0;
+	bool isInjecting = false;
+	int injectedInputsLeft = 0;
+	int injectFrame = 0;
+
+	GestureRecognizer gestures;
+	TouchRegionGrid menuRegions;
+	TouchRegionGrid gameplayRegions;
+	TouchRegionGrid pauseRegions;
+	TouchRegionGrid gameOverRegions;
+	TouchRegionGrid replayRegions;
 
 	Rectangle leftBtn;
 	Rectangle rightBtn;
@@ -51,10 +149,36 @@ private:
 	Rectangle rotateRightBtn;
 	Rectangle dropBtn;
 	Rectangle pauseBtn;
+	Rectangle placeModeBtn;
 
 	Rectangle startBtn;
 	Rectangle resumeBtn;
 	Rectangle restartBtn;
+	Rectangle watchBtn;
+
+	Rectangle replayBar;
+	Rectangle backBtn;
+
+	std::optional<Tetromino> currentTetromino;
+
+	// Tap to place, touches on the board pick a target cell instead of swiping. While
+	// the finger is down a ghost shows where the piece will go, releasing sends it there.
+	PathPlanner planner;
+	bool isPlaceMode = false;
+	bool isPlacing = false;
+	bool hasGhost = false;
+	Vec2<int> placeCell;
+	PathPlanner::Placement ghost = {};
+
+#ifndef PLATFORM_WEB
+	// Only exists while the spectator wall is shown
+	std::optional<SpectatorWall> spectatorWall;
 
-	std::unique_ptr<Tetromino> currentTetromino;
+	// Placement hint, H toggles it. The engine and its thread are created the first time.
+	std::optional<HintEngine> hintEngine;
+	bool isHintVisible = false;
+	bool hasHint = false;
+	uint64_t hintKey = 0;
+	HintEngine::Hint hint = {};
+#endif
 };
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include "Settings.h"
+
+// Everything needed to continue a game exactly, as one flat trivially copyable block
+struct GameSnapshot
+{
+	static constexpr int width = settings::boardWidthHeight.GetX();
+	static constexpr int height = settings::boardWidthHeight.GetY();
+
+	uint64_t seed;
+	uint64_t randomizerState;
+	int32_t elapsedTicks;
+	int32_t speedLevel;
+	int32_t pieceType;
+	int32_t pieceX;
+	int32_t pieceY;
+	int32_t pieceRotation;
+	int32_t gravityAccumulator;
+	int32_t score;
+	int32_t lines;
+	int32_t reserved;
+	uint32_t rowMasks[height];
+	uint32_t cellColors[width * height];	// Packed RGBA, only meaningful where the row mask is set
+};
\ No newline at end of file
@@ -4,5 +4,7 @@ enum class GameState {
     MainMenu,
     Gameplay,
     Pause,
-    GameOver // Add more states as needed
+    GameOver,
+    Replay,
+    Spectate // Add more states as needed
 };
\ No newline at end of file
@@ -1,23 +1,48 @@
 #include <random>
-#include <memory>
+#include <assert.h>
+#include "GameUtils.h"
 #include "Board.h"
-#include "Tetromino.h"
 
-std::unique_ptr<Tetromino> GenerateRandomTetromino(Board& board) {
+uint64_t GenerateSeed()
+{
     static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 6);
+    return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+}
 
-    int tetrominoType = dis(gen);
+void CaptureBoard(const Board& board, GameSnapshot& snapshot)
+{
+    assert(board.GetWidth() == GameSnapshot::width && board.GetHeight() == GameSnapshot::height);
+    for (int y = 0; y < GameSnapshot::height; ++y)
+    {
+        const uint32_t mask = board.GetRowMask(y);
+        snapshot.rowMasks[y] = mask;
+        for (int x = 0; x < GameSnapshot::width; ++x)
+        {
+            uint32_t packed = 0;
+            if (mask & (1u << x))
+            {
+                const Color c = board.GetCellColor({ x, y });
+                packed = c.r | (c.g << 8) | (c.b << 16) | (static_cast<uint32_t>(c.a) << 24);
+            }
+            snapshot.cellColors[y * GameSnapshot::width + x] = packed;
+        }
+    }
+}
 
-    switch (tetrominoType) {
-    case 0: return std::make_unique<StraightTetromino>(board);
-    case 1: return std::make_unique<SquareTetromino>(board);
-    case 2: return std::make_unique<TeeTetromino>(board);
-    case 3: return std::make_unique<JayTetromino>(board);
-    case 4: return std::make_unique<EllTetromino>(board);
-    case 5: return std::make_unique<SkewSTetromino>(board);
-    case 6: return std::make_unique<SkewZTetromino>(board);
-    default: throw std::runtime_error("Invalid Tetromino type");
+void RestoreBoard(const GameSnapshot& snapshot, Board& board)
+{
+    assert(board.GetWidth() == GameSnapshot::width && board.GetHeight() == GameSnapshot::height);
+    board.Reset();
+    for (int y = 0; y < GameSnapshot::height; ++y)
+    {
+        for (int x = 0; x < GameSnapshot::width; ++x)
+        {
+            if (snapshot.rowMasks[y] & (1u << x))
+            {
+                const uint32_t c = snapshot.cellColors[y * GameSnapshot::width + x];
+                board.SetCell({ x, y }, Color{ static_cast<unsigned char>(c), static_cast<unsigned char>(c >> 8),
+                    static_cast<unsigned char>(c >> 16), static_cast<unsigned char>(c >> 24) });
+            }
+        }
     }
 }
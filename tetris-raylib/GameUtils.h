@@ -1,7 +1,12 @@
 #pragma once
 
-#include <memory>
-#include "Tetromino.h"
+#include <cstdint>
+#include "Pieces.h"
 #include "Board.h"
+#include "GameSnapshot.h"
 
-std::unique_ptr<Tetromino> GenerateRandomTetromino(Board& board);
+uint64_t GenerateSeed();
+
+// Copy the settled cells between a board and the flat snapshot layout
+void CaptureBoard(const Board& board, GameSnapshot& snapshot);
+void RestoreBoard(const GameSnapshot& snapshot, Board& board);
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "Gestures.h"
+#include "Settings.h"
+#include <assert.h>
+#include <cmath>
+#include <algorithm>
+
+TouchRegionGrid::TouchRegionGrid(int screenWidth, int screenHeight, int gridCellSize)
+	:
+	gridCellSize(gridCellSize),
+	gridWidth((screenWidth + gridCellSize - 1) / gridCellSize),
+	gridHeight((screenHeight + gridCellSize - 1) / gridCellSize)
+{
+	assert(gridCellSize > 0 && gridWidth > 0 && gridHeight > 0);
+	grid.resize(gridWidth * gridHeight);
+}
+
+void TouchRegionGrid::Resize(int screenWidth, int screenHeight)
+{
+	gridWidth = (screenWidth + gridCellSize - 1) / gridCellSize;
+	gridHeight = (screenHeight + gridCellSize - 1) / gridCellSize;
+	assert(gridWidth > 0 && gridHeight > 0);
+	regions.clear();
+	grid.assign(gridWidth * gridHeight, GridCell());
+}
+
+void TouchRegionGrid::Clear()
+{
+	regions.clear();
+	for (GridCell& cell : grid)
+	{
+		cell.count = 0;
+	}
+}
+
+void TouchRegionGrid::AddRegion(int id, Rectangle rect)
+{
+	assert(id >= 0);
+	regions.push_back({ id, rect });
+}
+
+void TouchRegionGrid::Build()
+{
+	assert(regions.size() <= INT8_MAX);
+	for (GridCell& cell : grid)
+	{
+		cell.count = 0;
+	}
+
+	for (int i = 0; i < static_cast<int>(regions.size()); ++i)
+	{
+		const Rectangle& r = regions[i].rect;
+		const int x0 = std::clamp(static_cast<int>(r.x) / gridCellSize, 0, gridWidth - 1);
+		const int y0 = std::clamp(static_cast<int>(r.y) / gridCellSize, 0, gridHeight - 1);
+		const int x1 = std::clamp(static_cast<int>(r.x + r.width) / gridCellSize, 0, gridWidth - 1);
+		const int y1 = std::clamp(static_cast<int>(r.y + r.height) / gridCellSize, 0, gridHeight - 1);
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				GridCell& cell = grid[y * gridWidth + x];
+				assert(cell.count < maxRegionsPerCell);	// Make the grid finer if buttons are this dense
+				cell.regions[cell.count++] = static_cast<int8_t>(i);
+			}
+		}
+	}
+}
+
+int TouchRegionGrid::CellIndex(Vector2 pos) const
+{
+	if (pos.x < 0 || pos.y < 0)
+		return -1;
+	const int x = static_cast<int>(pos.x) / gridCellSize;
+	const int y = static_cast<int>(pos.y) / gridCellSize;
+	if (x >= gridWidth || y >= gridHeight)
+		return -1;
+	return y * gridWidth + x;
+}
+
+int TouchRegionGrid::HitTest(Vector2 pos) const
+{
+	const int index = CellIndex(pos);
+	if (index < 0)
+		return noRegion;
+
+	const GridCell& cell = grid[index];
+	for (int i = 0; i < cell.count; ++i)
+	{
+		const Region& region = regions[cell.regions[i]];
+		if (CheckCollisionPointRec(pos, region.rect))
+			return region.id;
+	}
+	return noRegion;
+}
+
+void GestureRecognizer::PushEvent(GestureType type, const TouchPoint& touch)
+{
+	if (eventCount < maxEvents)
+	{
+		events[eventCount++] = { type, touch.region, touch.lastPos };
+	}
+}
+
+void GestureRecognizer::Inject(GestureType type, int region, Vector2 pos)
+{
+	if (eventCount < maxEvents)
+	{
+		events[eventCount++] = { type, region, pos };
+	}
+}
+
+void GestureRecognizer::UpdateTouch(TouchPoint& touch, Vector2 pos, double time)
+{
+	if (pos.x != touch.lastPos.x || pos.y != touch.lastPos.y)
+	{
+		touch.lastPos = pos;
+		PushEvent(GestureType::Move, touch);
+	}
+
+	const float dx = pos.x - touch.startPos.x;
+	const float dy = pos.y - touch.startPos.y;
+	const float distance = settings::swipeDistance;
+	if (std::abs(dx) >= distance || std::abs(dy) >= distance)
+	{
+		if (std::abs(dx) >= std::abs(dy))
+			PushEvent(dx < 0 ? GestureType::SwipeLeft : GestureType::SwipeRight, touch);
+		else
+			PushEvent(dy < 0 ? GestureType::SwipeUp : GestureType::SwipeDown, touch);
+
+		// Restart from here so a long drag produces one swipe per swipe distance
+		touch.startPos = pos;
+		touch.bMoved = true;
+	}
+	else if (!touch.bMoved && !touch.bLongPressed && time - touch.startTime >= settings::longPressTime)
+	{
+		PushEvent(GestureType::LongPress, touch);
+		touch.bLongPressed = true;
+	}
+}
+
+void GestureRecognizer::Update(const TouchRegionGrid& regions, double time)
+{
+	eventCount = 0;
+	for (int i = 0; i < touchCount; ++i)
+	{
+		touches[i].bSeen = false;
+	}
+
+	const int pointCount = std::min(GetTouchPointCount(), maxTouchPoints);
+	for (int p = 0; p < pointCount; ++p)
+	{
+		const int id = GetTouchPointId(p);
+		const Vector2 pos = GetTouchPosition(p);
+
+		auto it = std::find_if(touches.begin(), touches.begin() + touchCount,
+			[id](const TouchPoint& t) { return t.id == id; });
+		if (it != touches.begin() + touchCount)
+		{
+			it->bSeen = true;
+			UpdateTouch(*it, pos, time);
+			continue;
+		}
+
+		if (touchCount < maxTouchPoints)
+		{
+			TouchPoint& touch = touches[touchCount++];
+			touch = { id, regions.HitTest(pos), pos, pos, time, false, false, true };
+			PushEvent(GestureType::Press, touch);
+		}
+	}
+
+	// Touches that disappeared this frame were released
+	for (int i = 0; i < touchCount;)
+	{
+		TouchPoint& touch = touches[i];
+		if (touch.bSeen)
+		{
+			++i;
+			continue;
+		}
+		PushEvent(GestureType::Release, touch);
+		if (!touch.bMoved && !touch.bLongPressed && time - touch.startTime <= settings::tapTime)
+		{
+			PushEvent(GestureType::Tap, touch);
+		}
+		touch = touches[--touchCount];
+	}
+}
+
+int GestureRecognizer::GetEventCount() const
+{
+	return eventCount;
+}
+
+const GestureEvent& GestureRecognizer::GetEvent(int i) const
+{
+	assert(i >= 0 && i < eventCount);
+	return events[i];
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include "raylibCpp.h"
+
+// Hit testing for on-screen buttons. Regions are bucketed into a coarse grid once,
+// so a lookup only checks the few rectangles overlapping the touched grid cell.
+class TouchRegionGrid
+{
+public:
+	static constexpr int noRegion = -1;
+public:
+	TouchRegionGrid(int screenWidth, int screenHeight, int gridCellSize);
+	// Covers a new screen size, the regions have to be added again
+	void Resize(int screenWidth, int screenHeight);
+	void Clear();
+	void AddRegion(int id, Rectangle rect);
+	void Build();
+	int HitTest(Vector2 pos) const;
+private:
+	static constexpr int maxRegionsPerCell = 4;
+	struct Region
+	{
+		int id;
+		Rectangle rect;
+	};
+	struct GridCell
+	{
+		std::array<int8_t, maxRegionsPerCell> regions;
+		int count = 0;
+	};
+	int CellIndex(Vector2 pos) const;
+private:
+	const int gridCellSize;
+	int gridWidth;
+	int gridHeight;
+	std::vector<Region> regions;
+	std::vector<GridCell> grid;
+};
+
+enum class GestureType
+{
+	Press,
+	Move,	// The touch moved since the last update, for dragging
+	Release,
+	Tap,
+	LongPress,
+	SwipeLeft,
+	SwipeRight,
+	SwipeUp,
+	SwipeDown
+};
+
+struct GestureEvent
+{
+	GestureType type;
+	int region;		// Region the touch started in
+	Vector2 pos;
+};
+
+// Tracks every active touch point and turns raw touch positions into gesture events.
+// Events are produced in the same Update call that observes them.
+class GestureRecognizer
+{
+public:
+	void Update(const TouchRegionGrid& regions, double time);
+	// Adds a synthetic event to this update's events, for driving the game without a touch screen
+	void Inject(GestureType type, int region, Vector2 pos);
+	int GetEventCount() const;
+	const GestureEvent& GetEvent(int i) const;
+private:
+	static constexpr int maxTouchPoints = 10;
+	static constexpr int maxEvents = maxTouchPoints * 4;
+	struct TouchPoint
+	{
+		int id;
+		int region;
+		Vector2 startPos;
+		Vector2 lastPos;
+		double startTime;
+		bool bMoved;
+		bool bLongPressed;
+		bool bSeen;
+	};
+	void PushEvent(GestureType type, const TouchPoint& touch);
+	void UpdateTouch(TouchPoint& touch, Vector2 pos, double time);
+private:
+	std::array<TouchPoint, maxTouchPoints> touches;
+	int touchCount = 0;
+	std::array<GestureEvent, maxEvents> events;
+	int eventCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Gravity in fixed point rows per simulation tick. Pieces accumulate it every tick
+// and fall one row per whole row accumulated, so fall speed depends only on the
+// tick count and never on frame rate or floating point rounding.
+namespace gravity
+{
+	inline constexpr int fractionBits = 16;
+	inline constexpr int32_t oneRow = 1 << fractionBits;
+	inline constexpr int maxLevel = 20;
+
+	// Rounded up so a piece falls on exactly the ticksPerRow'th tick
+	constexpr int32_t EveryNTicks(int ticksPerRow)
+	{
+		return (oneRow + ticksPerRow - 1) / ticksPerRow;
+	}
+
+	constexpr int32_t RowsPerTick(int numerator, int denominator)
+	{
+		return numerator * oneRow / denominator;
+	}
+
+	// Levels 1-10 match the old 1.0s to 0.1s drop intervals at 60 ticks per second,
+	// higher levels keep speeding up until pieces hit the floor immediately (20G)
+	inline constexpr std::array<int32_t, maxLevel> levelTable = {
+		EveryNTicks(60), EveryNTicks(54), EveryNTicks(48), EveryNTicks(42), EveryNTicks(36),
+		EveryNTicks(30), EveryNTicks(24), EveryNTicks(18), EveryNTicks(12), EveryNTicks(6),
+		EveryNTicks(4), EveryNTicks(3), EveryNTicks(2), RowsPerTick(1, 1), RowsPerTick(3, 2),
+		RowsPerTick(2, 1), RowsPerTick(3, 1), RowsPerTick(5, 1), RowsPerTick(10, 1), RowsPerTick(20, 1)
+	};
+
+	constexpr int32_t ForLevel(int level)
+	{
+		return levelTable[level < 1 ? 0 : (level > maxLevel ? maxLevel - 1 : level - 1)];
+	}
+
+	static_assert(ForLevel(1) * 60 >= oneRow && ForLevel(1) * 59 < oneRow);
+	static_assert(ForLevel(maxLevel) == 20 * oneRow);
+}
\ No newline at end of file
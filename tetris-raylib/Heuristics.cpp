@@ -0,0 +1,208 @@
+#include "Heuristics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <assert.h>
+#include "Bits.h"
+#include "Board.h"
+#include "Settings.h"
+
+int heuristics::ApplyPlacement(uint32_t* rows, int width, int height, PieceType type, const PathPlanner::Placement& placement)
+{
+	const pieces::Footprint& f = pieces::GetFootprint(type, placement.rotation);
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		rows[placement.y + r] |= placement.x >= 0 ? f.rows[r] << placement.x : f.rows[r] >> -placement.x;
+	}
+
+	const uint32_t fullRow = (1u << width) - 1;
+	int cleared = 0;
+	int write = height - 1;
+	for (int y = height - 1; y >= 0; --y)
+	{
+		if (rows[y] == fullRow)
+		{
+			++cleared;
+			continue;
+		}
+		rows[write--] = rows[y];
+	}
+	for (; write >= 0; --write)
+	{
+		rows[write] = 0;
+	}
+	return cleared;
+}
+
+namespace
+{
+	// Rows of the standard board are counted by table lookups, no popcount needed
+	constexpr int tableWidth = settings::boardWidthHeight.GetX();
+	static_assert(tableWidth <= 12, "The row tables have an entry per row mask");
+
+	struct RowTables
+	{
+		std::array<uint8_t, 1 << tableWidth> cells;
+		std::array<uint8_t, 1 << tableWidth> transitions;	// With the filled walls on both sides
+		std::array<uint64_t, 1 << tableWidth> heightLanes;	// A one in the height lane of each filled column
+	};
+	// Column heights of the standard board packed into one word while the rows are scanned
+	constexpr int heightLaneBits = 6;
+	constexpr uint64_t heightLaneMask = (1u << heightLaneBits) - 1;
+	static_assert(tableWidth * heightLaneBits <= 64 && heuristics::maxHeight < 1 << heightLaneBits);
+
+	constexpr RowTables MakeRowTables()
+	{
+		RowTables tables = {};
+		for (uint32_t row = 0; row < 1u << tableWidth; ++row) {
+			const uint32_t walled = row << 1 | 1u | 1u << (tableWidth + 1);
+			for (int x = 0; x <= tableWidth; ++x) {
+				tables.cells[row] += x < tableWidth ? (row >> x) & 1u : 0u;
+				tables.transitions[row] += ((walled >> x) ^ (walled >> (x + 1))) & 1u;
+				tables.heightLanes[row] |= x < tableWidth ? static_cast<uint64_t>((row >> x) & 1u) << (x * heightLaneBits) : 0u;
+			}
+		}
+		return tables;
+	}
+	constexpr RowTables rowTables = MakeRowTables();
+
+	// W fixes the width at compile time and uses the tables, dynamicBoardSize takes it at run time
+	template<int W>
+	void Extract(const uint32_t* rows, int runtimeWidth, int height, heuristics::BoardFeatures& features)
+	{
+		constexpr bool isTableWidth = W == tableWidth;
+		const int width = W != dynamicBoardSize ? W : runtimeWidth;
+		const uint32_t fullRow = (1u << width) - 1;
+		// A row shifted in by one between two filled wall cells
+		const uint32_t walls = 1u | 1u << (width + 1);
+		const uint32_t transitionMask = (1u << (width + 1)) - 1;
+		const auto countCells = [](uint32_t mask) {
+			if constexpr (isTableWidth)
+				return static_cast<int>(rowTables.cells[mask]);
+			else
+				return bits::PopCount(mask);
+		};
+		const auto countTransitions = [&](uint32_t row) {
+			if constexpr (isTableWidth)
+				return static_cast<int>(rowTables.transitions[row]);
+			else {
+				const uint32_t walled = row << 1 | walls;
+				return bits::PopCount((walled ^ walled >> 1) & transitionMask);
+			}
+		};
+
+		// Empty rows above the stack only have the two transitions against the walls.
+		// Every field is written below, columns past the width are left as they were.
+		int top = 0;
+		while (top < height && rows[top] == 0)
+		{
+			++top;
+		}
+
+		// One pass up from the floor. A filled cell is covered when its column has an empty
+		// cell below it, and every such empty cell is a hole, so the holes follow from the
+		// column heights less the filled cells.
+		int cells = 0;
+		int coveredCells = 0;
+		int rowTransitions = 2 * top;
+		int columnTransitions = 0;
+		uint64_t heightLanes = 0;
+		uint32_t emptyBelow = 0;
+		uint32_t previous = fullRow;	// The floor is filled
+		for (int y = height - 1; y >= top; --y)
+		{
+			const uint32_t row = rows[y];
+			cells += countCells(row);
+			coveredCells += countCells(row & emptyBelow);
+			emptyBelow |= ~row & fullRow;
+			rowTransitions += countTransitions(row);
+			columnTransitions += countCells(row ^ previous);
+			previous = row;
+			if constexpr (isTableWidth)
+			{
+				// Higher rows overwrite the lanes of their filled columns
+				const uint64_t lanes = rowTables.heightLanes[row];
+				heightLanes = (heightLanes & ~(lanes * heightLaneMask)) | lanes * static_cast<uint64_t>(height - y);
+			}
+		}
+		// The top of the stack against the empty rows above it, nothing is above the first row
+		if (top > 0)
+		{
+			columnTransitions += countCells(previous);
+		}
+
+		// Heights with the walls as full columns on both sides
+		std::array<int, heuristics::maxWidth + 2> heights;
+		heights[0] = height;
+		heights[width + 1] = height;
+		if constexpr (isTableWidth)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				heights[x + 1] = static_cast<int>((heightLanes >> (x * heightLaneBits)) & heightLaneMask);
+			}
+		}
+		else
+		{
+			std::fill(heights.begin() + 1, heights.begin() + width + 1, 0);
+			// Each column's top cell is in the first row it shows up in
+			uint32_t above = 0;
+			for (int y = top; y < height && above != fullRow; ++y)
+			{
+				for (uint32_t tops = rows[y] & ~above; tops != 0; tops &= tops - 1)
+				{
+					heights[bits::CountTrailingZeros(tops) + 1] = height - y;
+				}
+				above |= rows[y];
+			}
+		}
+
+		int aggregateHeight = 0;
+		int maxColumnHeight = 0;
+		int bumpiness = 0;
+		int wellSum = 0;
+		for (int x = 0; x < width; ++x)
+		{
+			const int columnHeight = heights[x + 1];
+			const int wellDepth = std::max(0, std::min(heights[x], heights[x + 2]) - columnHeight);
+			aggregateHeight += columnHeight;
+			maxColumnHeight = std::max(maxColumnHeight, columnHeight);
+			features.columnHeights[x] = static_cast<uint8_t>(columnHeight);
+			features.wellDepths[x] = static_cast<uint8_t>(wellDepth);
+			wellSum += wellDepth;
+		}
+		// Between neighbouring columns only, not against the walls
+		for (int x = 1; x < width; ++x)
+		{
+			bumpiness += std::abs(heights[x + 1] - heights[x]);
+		}
+
+		features.aggregateHeight = aggregateHeight;
+		features.maxColumnHeight = maxColumnHeight;
+		features.holes = aggregateHeight - cells;
+		features.coveredCells = coveredCells;
+		features.rowTransitions = rowTransitions;
+		features.columnTransitions = columnTransitions;
+		features.bumpiness = bumpiness;
+		features.wellSum = wellSum;
+	}
+}
+
+void heuristics::ExtractFeatures(const uint32_t* rows, int width, int height, BoardFeatures& features)
+{
+	assert(width > 0 && width <= maxWidth && height > 0 && height <= maxHeight);
+	if (width == tableWidth)
+	{
+		Extract<tableWidth>(rows, width, height, features);
+	}
+	else
+	{
+		Extract<dynamicBoardSize>(rows, width, height, features);
+	}
+}
+
+int heuristics::ScoreBoard(const uint32_t* rows, int width, int height, int cleared)
+{
+	BoardFeatures features;
+	ExtractFeatures(rows, width, height, features);
+	return cleared * 76 - features.aggregateHeight * 51 - features.holes * 36 - features.bumpiness * 18;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "Pieces.h"
+#include "PathPlanner.h"
+
+// Placement scoring shared by the spectator bots and the hint overlay. Boards are row
+// bitmasks as for PathPlanner.
+namespace heuristics
+{
+	constexpr int maxWidth = PathPlanner::maxWidth;
+	constexpr int maxHeight = PathPlanner::maxHeight;
+
+	// What bots and analytics evaluate a board by
+	struct BoardFeatures
+	{
+		std::array<uint8_t, maxWidth> columnHeights;	// Rows from the floor up to the top filled cell
+		std::array<uint8_t, maxWidth> wellDepths;	// How far the column is below both neighbours, walls are as high as the board
+		int aggregateHeight;
+		int maxColumnHeight;
+		int holes;	// Empty cells with a filled cell above them in the column
+		int coveredCells;	// Filled cells with a hole below them in the column
+		int rowTransitions;	// Changes between filled and empty along rows, the walls count as filled
+		int columnTransitions;	// Along columns, the floor counts as filled
+		int bumpiness;	// Height differences between neighbouring columns
+		int wellSum;
+	};
+
+	// One pass over the rows with bit operations, the column loop only touches the heights.
+	// Rows of the standard width are counted with lookup tables, others with popcounts.
+	// Entries of the column arrays past width are left untouched. FeatureCheck holds this
+	// against a per cell count and times it.
+	void ExtractFeatures(const uint32_t* rows, int width, int height, BoardFeatures& features);
+
+	// Locks the piece into rows and clears full rows like the Board, returns the rows cleared
+	int ApplyPlacement(uint32_t* rows, int width, int height, PieceType type, const PathPlanner::Placement& placement);
+
+	// A cheap stacking heuristic, higher is better
+	int ScoreBoard(const uint32_t* rows, int width, int height, int cleared);
+}
\ No newline at end of file
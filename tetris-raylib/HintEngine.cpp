@@ -0,0 +1,166 @@
+#include "HintEngine.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+#include "Heuristics.h"
+#include "Settings.h"
+
+namespace
+{
+	// Losing is worse than any board
+	constexpr int64_t topOutValue = std::numeric_limits<int32_t>::min();
+	constexpr int pieceTypeCount = static_cast<int>(PieceType::Count);
+}
+
+HintEngine::HintEngine()
+{
+	thread = std::thread(&HintEngine::Run, this);
+}
+
+HintEngine::~HintEngine() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		isStopping = true;
+	}
+	wakeSignal.notify_one();
+	thread.join();
+}
+
+void HintEngine::Request(uint64_t key, const uint32_t* rows, int width, int height, PieceType type, PieceType next, PathPlanner::Placement start)
+{
+	assert(width <= PathPlanner::maxWidth && height <= PathPlanner::maxHeight);
+	if (key == requestedKey)
+		return;
+	requestedKey = key;
+
+	Position& position = requests.GetWriteBuffer();
+	position.key = key;
+	std::copy(rows, rows + height, position.rows.begin());
+	position.width = width;
+	position.height = height;
+	position.type = type;
+	position.next = next;
+	position.start = start;
+	requests.Publish();
+	requestSequence.fetch_add(1, std::memory_order_release);
+	wakeSignal.notify_one();
+}
+
+bool HintEngine::FetchHint(uint64_t key, Hint& hint)
+{
+	if (!hints.Fetch() || hints.GetReadBuffer().key != key)
+		return false;
+	hint = hints.GetReadBuffer();
+	return true;
+}
+
+void HintEngine::Run()
+{
+	// Optional, without a book every position is searched
+	book.Open(settings::openingBookPath, settings::boardWidthHeight.GetX(), settings::boardWidthHeight.GetY());
+	while (!isStopping)
+	{
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wakeSignal.wait_for(lock, recheckInterval, [this] {
+				return isStopping || requestSequence.load(std::memory_order_acquire) != searchedSequence;
+			});
+		}
+		if (isStopping || requestSequence.load(std::memory_order_acquire) == searchedSequence)
+			continue;
+
+		searchedSequence = requestSequence.load(std::memory_order_acquire);
+		isCancelled = false;
+		requests.Fetch();
+		SearchPosition(requests.GetReadBuffer());
+	}
+}
+
+void HintEngine::SearchPosition(const Position& position)
+{
+	// The first planner keeps the current piece's placements for every depth, the lookahead uses the others
+	PathPlanner& planner = planners[0];
+	if (!planner.Search(position.rows.data(), position.width, position.height, position.type, position.start) ||
+		PublishBookPlacement(position))
+		return;
+
+	std::array<uint32_t, PathPlanner::maxHeight> rows;
+	for (int depth = 1; depth <= maxDepth; ++depth)
+	{
+		int best = -1;
+		int64_t bestValue = 0;
+		for (int p = 0; p < planner.GetPlacementCount(); ++p)
+		{
+			std::copy_n(position.rows.begin(), position.height, rows.begin());
+			const int cleared = heuristics::ApplyPlacement(rows.data(), position.width, position.height, position.type, planner.GetPlacement(p));
+			const int64_t value = rows[0] != 0 ? topOutValue : Lookahead(position, rows.data(), cleared, depth - 1, 1);
+			if (IsCancelled())
+				return;
+			if (best < 0 || value > bestValue)
+			{
+				best = p;
+				bestValue = value;
+			}
+		}
+		if (best < 0)
+			return;
+
+		Hint& hint = hints.GetWriteBuffer();
+		hint = { position.key, planner.GetPlacement(best), depth };
+		hints.Publish();
+	}
+}
+
+bool HintEngine::PublishBookPlacement(const Position& position)
+{
+	// The book searched deeper than the engine would, so its move is final. It was
+	// found from the spawn, the piece may have moved out of its reach since.
+	PathPlanner::Placement placement;
+	const uint64_t key = OpeningBook::MakeKey(position.rows.data(), position.height, position.type, position.next);
+	if (!book.Find(key, placement) || planners[0].FindPlacement(placement) < 0)
+		return false;
+
+	Hint& hint = hints.GetWriteBuffer();
+	hint = { position.key, placement, maxDepth };
+	hints.Publish();
+	return true;
+}
+
+int64_t HintEngine::Lookahead(const Position& position, const uint32_t* rows, int cleared, int depth, int level)
+{
+	if (depth == 0)
+		return heuristics::ScoreBoard(rows, position.width, position.height, cleared);
+
+	// Sum rather than average over the next piece, siblings are only compared with each other
+	PathPlanner& planner = planners[level];
+	std::array<uint32_t, PathPlanner::maxHeight> next;
+	int64_t total = 0;
+	for (int t = 0; t < pieceTypeCount && !IsCancelled(); ++t)
+	{
+		const PieceType type = static_cast<PieceType>(t);
+		const PathPlanner::Placement spawn = { pieces::SpawnX(type, position.width), 0, 0 };
+		int64_t best = topOutValue;
+		if (planner.Search(rows, position.width, position.height, type, spawn))
+		{
+			for (int p = 0; p < planner.GetPlacementCount() && !IsCancelled(); ++p)
+			{
+				std::copy_n(rows, position.height, next.begin());
+				const int nextCleared = heuristics::ApplyPlacement(next.data(), position.width, position.height, type, planner.GetPlacement(p));
+				if (next[0] != 0)
+					continue;
+				best = std::max(best, Lookahead(position, next.data(), cleared + nextCleared, depth - 1, level + 1));
+			}
+		}
+		total += best;
+		// Let the render and simulation threads have the core back on small devices
+		std::this_thread::yield();
+	}
+	return total;
+}
+
+bool HintEngine::IsCancelled()
+{
+	isCancelled = isCancelled || isStopping || requestSequence.load(std::memory_order_relaxed) != searchedSequence;
+	return isCancelled;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Pieces.h"
+#include "PathPlanner.h"
+#include "TripleBuffer.h"
+#include "OpeningBook.h"
+
+// Suggests a placement for the falling piece, searched on a worker thread so a frame
+// never waits for it. A position is searched with iterative deepening: the current
+// piece alone, then with the expected best follow-up over every possible next piece,
+// and so on. The best placement of every finished depth is published through a triple
+// buffer. A new request cancels the running search after at most one placement search.
+// Positions in the opening book get the book's placement straight away.
+//
+// The render thread never takes a lock here. It notifies the worker without one and
+// the worker rechecks for requests regularly, so a wakeup lost to that race only
+// delays the hint a little. Desktop only.
+class HintEngine
+{
+public:
+	static constexpr int maxDepth = 3;
+	struct Hint
+	{
+		uint64_t key;	// Of the request it answers
+		PathPlanner::Placement placement;
+		int depth;	// Pieces looked at, deeper is better
+	};
+public:
+	// Starts the worker thread
+	HintEngine();
+	HintEngine(const HintEngine&) = delete;
+	HintEngine& operator=(const HintEngine&) = delete;
+	~HintEngine() noexcept;
+
+	// Render thread side. key identifies the position, requesting the one already
+	// searched again does nothing. rows as for PathPlanner, next is the piece after type.
+	void Request(uint64_t key, const uint32_t* rows, int width, int height, PieceType type, PieceType next, PathPlanner::Placement start);
+	// True when a better hint for key arrived since the last call
+	bool FetchHint(uint64_t key, Hint& hint);
+private:
+	static constexpr auto recheckInterval = std::chrono::milliseconds(20);
+	struct Position
+	{
+		uint64_t key;
+		std::array<uint32_t, PathPlanner::maxHeight> rows;
+		int width;
+		int height;
+		PieceType type;
+		PieceType next;
+		PathPlanner::Placement start;
+	};
+
+	void Run();
+	void SearchPosition(const Position& position);
+	bool PublishBookPlacement(const Position& position);
+	// Expected value of the board over every next piece, looking depth pieces ahead
+	int64_t Lookahead(const Position& position, const uint32_t* rows, int cleared, int depth, int level);
+	bool IsCancelled();
+private:
+	// Render thread side
+	TripleBuffer<Position> requests;
+	TripleBuffer<Hint> hints;
+	std::atomic<uint32_t> requestSequence = 0;
+	uint64_t requestedKey = 0;
+
+	// Worker side, one planner per piece looked ahead
+	std::array<PathPlanner, maxDepth> planners;
+	OpeningBook book;
+	uint32_t searchedSequence = 0;
+	bool isCancelled = false;
+
+	std::thread thread;
+	std::atomic<bool> isStopping = false;
+	std::mutex wakeMutex;
+	std::condition_variable wakeSignal;
+};
\ No newline at end of file
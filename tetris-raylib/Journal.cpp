@@ -0,0 +1,197 @@
+#include "Journal.h"
+#include <cstring>
+#include <assert.h>
+#include "Persistence.h"
+
+namespace
+{
+	// FNV-1a, small and fast enough to checksum every record on the frame path
+	uint32_t Checksum(const void* data, size_t size, uint32_t hash = 2166136261u)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	int AlignUp(int value)
+	{
+		return (value + 3) & ~3;
+	}
+}
+
+bool Journal::Open(const std::string& path)
+{
+	assert(!IsOpen());
+	// The browser build keeps the file in IndexedDB
+	persistence::Mount();
+	if (!file.Open(path, fileSize))
+		return false;
+
+	FileHeader* header = GetHeader();
+	if (header->magic != magic || header->version != version)
+	{
+		// New or foreign file, start from scratch
+		std::memset(file.GetData(), 0, file.GetSize());
+		header->magic = magic;
+		header->version = version;
+	}
+	assert(file.GetSize() >= static_cast<size_t>(fileSize));
+	Recover();
+	return true;
+}
+
+bool Journal::IsOpen() const
+{
+	return file.IsOpen();
+}
+
+Journal::FileHeader* Journal::GetHeader()
+{
+	return reinterpret_cast<FileHeader*>(file.GetData());
+}
+
+Journal::CheckpointHeader* Journal::GetSlot(int index)
+{
+	return reinterpret_cast<CheckpointHeader*>(file.GetData() + sizeof(FileHeader) + index * slotStride);
+}
+
+const Journal::CheckpointHeader* Journal::GetSlot(int index) const
+{
+	return reinterpret_cast<const CheckpointHeader*>(file.GetData() + sizeof(FileHeader) + index * slotStride);
+}
+
+bool Journal::IsSlotValid(int index) const
+{
+	const CheckpointHeader* slot = GetSlot(index);
+	if (slot->generation == 0 || slot->size > static_cast<uint32_t>(maxCheckpointSize))
+		return false;
+	const uint32_t hash = Checksum(&slot->generation, sizeof(CheckpointHeader) - sizeof(uint32_t));
+	return slot->checksum == Checksum(slot + 1, slot->size, hash);
+}
+
+bool Journal::IsRecordValid(int offset) const
+{
+	if (offset + static_cast<int>(sizeof(RecordHeader)) > fileSize)
+		return false;
+	const RecordHeader* header = reinterpret_cast<const RecordHeader*>(file.GetData() + offset);
+	if (header->generation != generation || offset + static_cast<int>(sizeof(RecordHeader)) + header->size > fileSize)
+		return false;
+	const uint32_t hash = Checksum(&header->generation, sizeof(RecordHeader) - sizeof(uint32_t));
+	return header->checksum == Checksum(header + 1, header->size, hash);
+}
+
+void Journal::Recover()
+{
+	newestSlot = -1;
+	generation = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (IsSlotValid(i) && GetSlot(i)->generation > generation)
+		{
+			generation = GetSlot(i)->generation;
+			newestSlot = i;
+		}
+	}
+
+	// Continue appending after the last intact record of the newest generation
+	writeOffset = recordAreaStart;
+	Record record;
+	int offset = 0;
+	while (ReadRecord(offset, record))
+	{
+	}
+	writeOffset = recordAreaStart + offset;
+}
+
+void Journal::WriteCheckpoint(const void* data, int size)
+{
+	assert(IsOpen());
+	assert(size >= 0 && size <= maxCheckpointSize);
+
+	// Write into the older slot so the newest checkpoint survives a torn write.
+	// Records of the previous generation stop validating once this one exists.
+	const int slotIndex = newestSlot == 0 ? 1 : 0;
+	CheckpointHeader* slot = GetSlot(slotIndex);
+	std::memcpy(slot + 1, data, size);
+	generation = ++GetHeader()->lastGeneration;
+	slot->generation = generation;
+	slot->size = static_cast<uint32_t>(size);
+	slot->reserved = 0;
+	const uint32_t hash = Checksum(&slot->generation, sizeof(CheckpointHeader) - sizeof(uint32_t));
+	slot->checksum = Checksum(data, size, hash);
+
+	newestSlot = slotIndex;
+	writeOffset = recordAreaStart;
+}
+
+bool Journal::Append(RecordType type, int32_t tick, const void* payload, int size)
+{
+	assert(IsOpen() && newestSlot >= 0);	// Records need a checkpoint to apply to
+	assert(size >= 0 && size <= UINT16_MAX);
+	const int recordSize = AlignUp(static_cast<int>(sizeof(RecordHeader)) + size);
+	if (writeOffset + recordSize > fileSize)
+		return false;
+
+	RecordHeader* header = reinterpret_cast<RecordHeader*>(file.GetData() + writeOffset);
+	std::memcpy(header + 1, payload, size);
+	header->generation = generation;
+	header->tick = tick;
+	header->type = static_cast<uint16_t>(type);
+	header->size = static_cast<uint16_t>(size);
+	const uint32_t hash = Checksum(&header->generation, sizeof(RecordHeader) - sizeof(uint32_t));
+	header->checksum = Checksum(payload, size, hash);
+
+	writeOffset += recordSize;
+	return true;
+}
+
+bool Journal::IsNearlyFull() const
+{
+	return writeOffset > recordAreaStart + (fileSize - recordAreaStart) * 3 / 4;
+}
+
+void Journal::Clear()
+{
+	if (!IsOpen())
+		return;
+	// Dropping both checkpoints is enough, all records hang off one of them
+	GetSlot(0)->generation = 0;
+	GetSlot(1)->generation = 0;
+	newestSlot = -1;
+	generation = 0;
+	writeOffset = recordAreaStart;
+	Flush();
+}
+
+void Journal::Flush()
+{
+	if (!IsOpen())
+		return;
+	file.Flush(true);
+	persistence::Sync();
+}
+
+const uint8_t* Journal::GetCheckpoint(int& size) const
+{
+	if (newestSlot < 0)
+		return nullptr;
+	const CheckpointHeader* slot = GetSlot(newestSlot);
+	size = static_cast<int>(slot->size);
+	return reinterpret_cast<const uint8_t*>(slot + 1);
+}
+
+bool Journal::ReadRecord(int& offset, Record& record) const
+{
+	if (newestSlot < 0 || !IsRecordValid(recordAreaStart + offset))
+		return false;
+	const RecordHeader* header = reinterpret_cast<const RecordHeader*>(file.GetData() + recordAreaStart + offset);
+	record.type = static_cast<RecordType>(header->type);
+	record.tick = header->tick;
+	record.payload = reinterpret_cast<const uint8_t*>(header + 1);
+	record.size = header->size;
+	offset += AlignUp(static_cast<int>(sizeof(RecordHeader)) + header->size);
+	return true;
+}
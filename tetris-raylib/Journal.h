@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+
+// Crash-safe autosave on a memory-mapped file. The file holds two checkpoint slots
+// and an append-only record area. Each checkpoint starts a new generation and every
+// record is tagged with its generation and a checksum, so after a crash the newest
+// intact checkpoint plus the records behind it describe the exact last state.
+// Appending is a memcpy into the mapping and never waits on the disk.
+class Journal
+{
+public:
+	enum class RecordType : uint16_t
+	{
+		Input = 1,
+		Lock = 2
+	};
+	struct Record
+	{
+		RecordType type;
+		int32_t tick;
+		const uint8_t* payload;
+		int size;
+	};
+public:
+	bool Open(const std::string& path);
+	bool IsOpen() const;
+	void WriteCheckpoint(const void* data, int size);
+	bool Append(RecordType type, int32_t tick, const void* payload, int size);
+	bool IsNearlyFull() const;
+	void Clear();
+	void Flush();
+
+	// Newest intact checkpoint, nullptr when there is nothing to restore
+	const uint8_t* GetCheckpoint(int& size) const;
+	// Iterate the records written after the newest checkpoint, start with offset 0
+	bool ReadRecord(int& offset, Record& record) const;
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t lastGeneration;	// Never reset, so stale records can't match a future checkpoint
+		uint32_t reserved;
+	};
+	struct CheckpointHeader
+	{
+		uint32_t checksum;
+		uint32_t generation;
+		uint32_t size;
+		uint32_t reserved;
+	};
+	struct RecordHeader
+	{
+		uint32_t checksum;
+		uint32_t generation;
+		int32_t tick;
+		uint16_t type;
+		uint16_t size;
+	};
+	static constexpr uint32_t magic = 0x4C4E524A;	// "JRNL"
+	static constexpr uint32_t version = 2;	// Records are replayed, so rule changes bump it too
+	static constexpr int fileSize = 64 * 1024;
+	static constexpr int recordAreaStart = 8 * 1024;
+	static constexpr int slotStride = (recordAreaStart - static_cast<int>(sizeof(FileHeader))) / 2;
+	static constexpr int maxCheckpointSize = slotStride - static_cast<int>(sizeof(CheckpointHeader));
+
+	FileHeader* GetHeader();
+	CheckpointHeader* GetSlot(int index);
+	const CheckpointHeader* GetSlot(int index) const;
+	bool IsSlotValid(int index) const;
+	bool IsRecordValid(int offset) const;
+	void Recover();
+private:
+	MappedFile file;
+	uint32_t generation = 0;
+	int newestSlot = -1;
+	int writeOffset = recordAreaStart;
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+	const char* kindNames[] = { "Key", "Button", "Swipe", "Tap", "LongPress", "Place" };
+	static_assert(sizeof(kindNames) / sizeof(kindNames[0]) == LatencyTracker::kindCount);
+
+	// Nearest rank on sorted values
+	float Percentile(const std::vector<float>& sorted, int percent)
+	{
+		const size_t rank = (sorted.size() * percent + 99) / 100;
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+}
+
+int64_t LatencyTracker::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyTracker::Enable()
+{
+	for (std::vector<Sample>& kindSamples : samples)
+	{
+		kindSamples.reserve(maxSamplesPerKind);
+	}
+	isEnabled = true;
+}
+
+bool LatencyTracker::IsEnabled() const
+{
+	return isEnabled;
+}
+
+void LatencyTracker::OnInputRead(InputKind kind, uint32_t commandSequence, int64_t readTime)
+{
+	if (!isEnabled)
+		return;
+	if (pendingCount == maxPending)
+	{
+		++droppedCount;
+		return;
+	}
+	pending[(pendingHead + pendingCount++) % maxPending] = { kind, commandSequence, readTime, 0, false };
+}
+
+void LatencyTracker::OnFrameFetched(uint32_t commandsConsumed, int64_t consumedTime)
+{
+	// Commands are consumed in order, so the fetched inputs are always the oldest ones
+	for (int i = 0; i < pendingCount; ++i)
+	{
+		Pending& p = pending[(pendingHead + i) % maxPending];
+		if (static_cast<int32_t>(commandsConsumed - p.commandSequence) < 0)
+			break;
+		if (!p.isFetched)
+		{
+			p.isFetched = true;
+			p.consumedTime = consumedTime;
+		}
+	}
+}
+
+void LatencyTracker::OnFramePresented(int64_t presentTime)
+{
+	while (pendingCount > 0 && pending[pendingHead].isFetched)
+	{
+		const Pending& p = pending[pendingHead];
+		std::vector<Sample>& kindSamples = samples[static_cast<int>(p.kind)];
+		if (kindSamples.size() < maxSamplesPerKind)
+		{
+			constexpr float nsPerMs = 1e6f;
+			kindSamples.push_back({ (p.consumedTime - p.readTime) / nsPerMs, (presentTime - p.consumedTime) / nsPerMs,
+				(presentTime - p.readTime) / nsPerMs });
+		}
+		pendingHead = (pendingHead + 1) % maxPending;
+		--pendingCount;
+	}
+}
+
+int LatencyTracker::GetPendingCount() const
+{
+	return pendingCount;
+}
+
+int LatencyTracker::GetSampleCount() const
+{
+	int count = 0;
+	for (const std::vector<Sample>& kindSamples : samples)
+	{
+		count += static_cast<int>(kindSamples.size());
+	}
+	return count;
+}
+
+bool LatencyTracker::WriteReport(const std::string& path) const
+{
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	std::fprintf(file, "%-10s %7s %27s %27s %27s\n", "input", "count", "read>consumed p50/p99/max", "consumed>shown p50/p99/max", "total p50/p99/max");
+	std::vector<float> values;
+	for (int kind = 0; kind < kindCount; ++kind)
+	{
+		const std::vector<Sample>& kindSamples = samples[kind];
+		if (kindSamples.empty())
+			continue;
+
+		std::fprintf(file, "%-10s %7d", kindNames[kind], static_cast<int>(kindSamples.size()));
+		for (float Sample::* stage : { &Sample::consumeMs, &Sample::displayMs, &Sample::totalMs })
+		{
+			values.clear();
+			for (const Sample& s : kindSamples)
+			{
+				values.push_back(s.*stage);
+			}
+			std::sort(values.begin(), values.end());
+			std::fprintf(file, "   %7.2f %7.2f %7.2f", Percentile(values, 50), Percentile(values, 99), values.back());
+		}
+		std::fprintf(file, "\n");
+	}
+	std::fprintf(file, "Times in ms, %d inputs dropped while %d were in flight\n", droppedCount, maxPending);
+	return std::fclose(file) == 0;
+}
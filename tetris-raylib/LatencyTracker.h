@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What produced an input, latency is reported per kind
+enum class InputKind : uint8_t
+{
+	Key,
+	Button,	// On-screen touch button
+	Swipe,
+	Tap,
+	LongPress,
+	Place,	// Tap to place release
+	Count
+};
+
+// Input to display latency. An input is stamped when the render thread reads it and
+// posts its command, the simulation reports when it consumed the command, and the
+// input is done when EndDrawing returns for the first frame drawn from a simulation
+// frame that includes it. The time an event spends in the OS queue before raylib
+// polls it is not visible from here.
+//
+// Disabled by default, every call is then a no-op. Enabling reserves all storage up
+// front, so recording never allocates on the frame path.
+class LatencyTracker
+{
+public:
+	static constexpr int kindCount = static_cast<int>(InputKind::Count);
+	static constexpr int maxPending = 64;
+	static constexpr int maxSamplesPerKind = 1 << 14;
+public:
+	// Steady clock in nanoseconds, comparable across threads
+	static int64_t Now();
+
+	void Enable();
+	bool IsEnabled() const;
+
+	// commandSequence is the number of commands posted so far, including this input's
+	void OnInputRead(InputKind kind, uint32_t commandSequence, int64_t readTime);
+	// A frame was fetched that reflects every command up to commandsConsumed
+	void OnFrameFetched(uint32_t commandsConsumed, int64_t consumedTime);
+	// EndDrawing returned for the frame fetched last
+	void OnFramePresented(int64_t presentTime);
+
+	int GetPendingCount() const;
+	int GetSampleCount() const;
+	// p50, p99 and max per input kind, from read to consumed, consumed to shown and in total
+	bool WriteReport(const std::string& path) const;
+private:
+	struct Pending
+	{
+		InputKind kind;
+		uint32_t commandSequence;
+		int64_t readTime;
+		int64_t consumedTime;
+		bool isFetched;
+	};
+	struct Sample
+	{
+		float consumeMs;
+		float displayMs;
+		float totalMs;
+	};
+private:
+	bool isEnabled = false;
+	std::array<Pending, maxPending> pending;
+	int pendingHead = 0;
+	int pendingCount = 0;
+	int droppedCount = 0;	// Inputs read while maxPending were still in flight
+	std::array<std::vector<Sample>, kindCount> samples;
+};
\ No newline at end of file
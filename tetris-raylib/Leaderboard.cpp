@@ -0,0 +1,309 @@
+#include "Leaderboard.h"
+#include "Settings.h"
+#include "Persistence.h"
+#include <algorithm>
+#include <cstdio>
+#include <assert.h>
+
+namespace
+{
+	// Log offsets in 64 bits, long is 32 bits on Windows and the log holds millions of results
+	bool Seek(FILE* file, uint64_t offset, int origin)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, static_cast<__int64>(offset), origin) == 0;
+#else
+		return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+	}
+
+	int64_t Tell(FILE* file)
+	{
+#ifdef _WIN32
+		return _ftelli64(file);
+#else
+		return static_cast<int64_t>(ftello(file));
+#endif
+	}
+}
+
+Leaderboard::Leaderboard(std::string logPath, std::string indexPath)
+	: logPath(std::move(logPath)), indexPath(std::move(indexPath))
+{
+}
+
+Leaderboard::~Leaderboard() noexcept
+{
+#ifndef PLATFORM_WEB
+	if (compactionThread.joinable())
+	{
+		compactionThread.join();
+	}
+#endif
+	// Install a finished index now rather than redoing the work on the next start
+	FinishCompaction();
+}
+
+bool Leaderboard::IsBetter(const LeaderboardEntry& a, const LeaderboardEntry& b)
+{
+	if (a.score != b.score) return a.score > b.score;
+	if (a.lines != b.lines) return a.lines > b.lines;
+	return a.ticks < b.ticks;
+}
+
+bool Leaderboard::SeedOrder(const LeaderboardEntry& a, const LeaderboardEntry& b)
+{
+	if (a.seed != b.seed) return a.seed < b.seed;
+	return IsBetter(a, b);
+}
+
+bool Leaderboard::Open()
+{
+	persistence::Mount();
+	index = LoadIndex();
+	const uint64_t covered = index ? index->coveredLogBytes : 0;
+	if (!LoadTail(covered))
+	{
+		// The log is the source of truth, an index that doesn't match it is rebuilt
+		index.reset();
+		if (!LoadTail(0))
+			return false;
+	}
+	if (tail.size() >= static_cast<size_t>(settings::leaderboardCompactionThreshold))
+	{
+		StartCompaction();
+	}
+	return true;
+}
+
+std::unique_ptr<Leaderboard::Index> Leaderboard::LoadIndex() const
+{
+	auto loaded = std::make_unique<Index>();
+	if (!loaded->file.OpenReadOnly(indexPath) || loaded->file.GetSize() < sizeof(IndexHeader))
+		return nullptr;
+
+	const uint8_t* data = static_cast<const MappedFile&>(loaded->file).GetData();
+	const IndexHeader* header = reinterpret_cast<const IndexHeader*>(data);
+	if (header->magic != magic || header->version != version ||
+		loaded->file.GetSize() != sizeof(IndexHeader) + 2 * header->count * sizeof(LeaderboardEntry))
+		return nullptr;
+
+	loaded->count = header->count;
+	loaded->coveredLogBytes = header->coveredLogBytes;
+	loaded->byScore = reinterpret_cast<const LeaderboardEntry*>(header + 1);
+	loaded->bySeed = loaded->byScore + header->count;
+	return loaded;
+}
+
+bool Leaderboard::LoadTail(uint64_t fromLogBytes)
+{
+	tail.clear();
+	logBytes = 0;
+
+	FILE* log = std::fopen(logPath.c_str(), "rb");
+	if (!log)
+	{
+		// No results yet
+		return fromLogBytes == 0;
+	}
+	const int64_t size = Seek(log, 0, SEEK_END) ? Tell(log) : -1;
+	// A record torn by a crash at the end of the log is ignored, Add writes over it
+	logBytes = size > 0 ? static_cast<uint64_t>(size) / sizeof(LeaderboardEntry) * sizeof(LeaderboardEntry) : 0;
+	if (size < 0 || fromLogBytes > logBytes || !Seek(log, fromLogBytes, SEEK_SET))
+	{
+		std::fclose(log);
+		return false;
+	}
+
+	tail.resize((logBytes - fromLogBytes) / sizeof(LeaderboardEntry));
+	const size_t read = std::fread(tail.data(), sizeof(LeaderboardEntry), tail.size(), log);
+	std::fclose(log);
+	tail.resize(read);
+	std::sort(tail.begin(), tail.end(), IsBetter);
+	return true;
+}
+
+void Leaderboard::Add(const LeaderboardEntry& entry)
+{
+	FinishCompaction();
+
+	// Appending would land after the bytes of a record torn by a crash and shift every
+	// record from then on, so the entry goes right after the last whole one. "ab" only
+	// creates the log when there is none yet.
+	if (FILE* created = std::fopen(logPath.c_str(), "ab"))
+	{
+		std::fclose(created);
+	}
+	FILE* log = std::fopen(logPath.c_str(), "r+b");
+	if (log)
+	{
+		// Only whole records count, so a crash mid-write loses at most this entry
+		bool isWritten = Seek(log, logBytes, SEEK_SET) && std::fwrite(&entry, sizeof(entry), 1, log) == 1;
+		isWritten = std::fclose(log) == 0 && isWritten;
+		if (isWritten)
+		{
+			logBytes += sizeof(entry);
+		}
+	}
+	tail.insert(std::upper_bound(tail.begin(), tail.end(), entry, IsBetter), entry);
+
+	if (tail.size() >= static_cast<size_t>(settings::leaderboardCompactionThreshold))
+	{
+		StartCompaction();
+	}
+	// A result is only kept in the browser once synced, the tab may be closed on the game over screen
+	persistence::Sync();
+}
+
+bool Leaderboard::WriteIndex(const std::string& path, const Index* oldIndex, std::vector<LeaderboardEntry> newEntries, uint64_t coveredLogBytes)
+{
+	const uint64_t oldCount = oldIndex ? oldIndex->count : 0;
+	IndexHeader header = { magic, version, oldCount + newEntries.size(), coveredLogBytes };
+
+	// Both sections are a linear merge of the old sorted index with the sorted new entries
+	std::vector<LeaderboardEntry> merged(header.count);
+	std::sort(newEntries.begin(), newEntries.end(), IsBetter);
+	std::merge(oldIndex ? oldIndex->byScore : nullptr, oldIndex ? oldIndex->byScore + oldCount : nullptr,
+		newEntries.begin(), newEntries.end(), merged.begin(), IsBetter);
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool isWritten = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(merged.data(), sizeof(LeaderboardEntry), merged.size(), file) == merged.size();
+
+	std::sort(newEntries.begin(), newEntries.end(), SeedOrder);
+	std::merge(oldIndex ? oldIndex->bySeed : nullptr, oldIndex ? oldIndex->bySeed + oldCount : nullptr,
+		newEntries.begin(), newEntries.end(), merged.begin(), SeedOrder);
+	isWritten = isWritten && std::fwrite(merged.data(), sizeof(LeaderboardEntry), merged.size(), file) == merged.size();
+	isWritten = std::fclose(file) == 0 && isWritten;
+	if (!isWritten)
+	{
+		std::remove(path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void Leaderboard::StartCompaction()
+{
+	if (isCompacting)
+		return;
+	isCompacting = true;
+	isCompactionDone = false;
+	compactingLogBytes = logBytes;
+
+	// The current index stays mapped and unchanged until FinishCompaction swaps it out
+	const Index* oldIndex = index.get();
+	std::vector<LeaderboardEntry> entries = tail;
+#ifdef PLATFORM_WEB
+	// No threads in the browser build, the tail is small enough to merge right away
+	isCompactionSuccessful = WriteIndex(indexPath + ".tmp", oldIndex, std::move(entries), compactingLogBytes);
+	isCompactionDone = true;
+	FinishCompaction();
+#else
+	if (compactionThread.joinable())
+	{
+		compactionThread.join();
+	}
+	compactionThread = std::thread([this, oldIndex, entries = std::move(entries)]() mutable
+	{
+		isCompactionSuccessful = WriteIndex(indexPath + ".tmp", oldIndex, std::move(entries), compactingLogBytes);
+		isCompactionDone = true;
+	});
+#endif
+}
+
+void Leaderboard::FinishCompaction()
+{
+	if (!isCompacting || !isCompactionDone)
+		return;
+#ifndef PLATFORM_WEB
+	if (compactionThread.joinable())
+	{
+		compactionThread.join();
+	}
+#endif
+	isCompacting = false;
+	if (!isCompactionSuccessful)
+		return;
+
+	// The old index has to be unmapped before it can be replaced on every platform.
+	// If this is interrupted the index is simply rebuilt from the log on the next start.
+	index.reset();
+	const std::string tempPath = indexPath + ".tmp";
+	std::remove(indexPath.c_str());
+	if (std::rename(tempPath.c_str(), indexPath.c_str()) == 0)
+	{
+		index = LoadIndex();
+	}
+
+	// Keep only the entries appended to the log while compaction was running
+	if (!LoadTail(index ? index->coveredLogBytes : 0))
+	{
+		index.reset();
+		LoadTail(0);
+	}
+}
+
+int Leaderboard::GetTop(LeaderboardEntry* out, int maxCount)
+{
+	FinishCompaction();
+
+	// Both sources are sorted, so the top entries are a merge of their heads
+	const LeaderboardEntry* indexed = index ? index->byScore : nullptr;
+	const LeaderboardEntry* indexedEnd = index ? index->byScore + index->count : nullptr;
+	auto tailIt = tail.begin();
+	int count = 0;
+	while (count < maxCount && (indexed != indexedEnd || tailIt != tail.end()))
+	{
+		if (tailIt == tail.end() || (indexed != indexedEnd && !IsBetter(*tailIt, *indexed)))
+			out[count++] = *indexed++;
+		else
+			out[count++] = *tailIt++;
+	}
+	return count;
+}
+
+int Leaderboard::GetBySeed(uint64_t seed, LeaderboardEntry* out, int maxCount)
+{
+	FinishCompaction();
+
+	// Every entry with this seed sorts after the empty key and before the next seed
+	const LeaderboardEntry* indexed = nullptr;
+	const LeaderboardEntry* indexedEnd = nullptr;
+	if (index)
+	{
+		LeaderboardEntry key = {};
+		key.seed = seed;
+		const auto bySeed = [](const LeaderboardEntry& a, const LeaderboardEntry& b) { return a.seed < b.seed; };
+		indexed = std::lower_bound(index->bySeed, index->bySeed + index->count, key, bySeed);
+		indexedEnd = std::upper_bound(indexed, index->bySeed + index->count, key, bySeed);
+	}
+
+	// Both are sorted best first, merge their heads like GetTop but skip other seeds in the tail
+	auto nextInTail = [this, seed](std::vector<LeaderboardEntry>::const_iterator it) {
+		return std::find_if(it, tail.cend(), [seed](const LeaderboardEntry& e) { return e.seed == seed; });
+	};
+	auto tailIt = nextInTail(tail.cbegin());
+	int count = 0;
+	while (count < maxCount && (indexed != indexedEnd || tailIt != tail.cend()))
+	{
+		if (tailIt == tail.cend() || (indexed != indexedEnd && !IsBetter(*tailIt, *indexed)))
+		{
+			out[count++] = *indexed++;
+		}
+		else
+		{
+			out[count++] = *tailIt;
+			tailIt = nextInTail(tailIt + 1);
+		}
+	}
+	return count;
+}
+
+int64_t Leaderboard::GetCount() const
+{
+	return static_cast<int64_t>((index ? index->count : 0) + tail.size());
+}
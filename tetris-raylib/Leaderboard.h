@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#ifndef PLATFORM_WEB
+#include <thread>
+#endif
+#include "MappedFile.h"
+
+struct LeaderboardEntry
+{
+	uint64_t seed;
+	int64_t timestamp;	// Unix time in seconds
+	int32_t score;
+	int32_t lines;
+	int32_t level;
+	int32_t ticks;
+};
+
+// Persistent local high scores. Results are appended to a log file, which is the
+// source of truth. A background compaction merges the log into a memory-mapped
+// index holding every result twice, sorted by score and by seed, so top-K and
+// per-seed queries stay fast with millions of results. Entries appended since the
+// last compaction are kept in a small in-memory tail and merged into every query.
+class Leaderboard
+{
+public:
+	Leaderboard(std::string logPath, std::string indexPath);
+	Leaderboard(const Leaderboard&) = delete;
+	Leaderboard& operator=(const Leaderboard&) = delete;
+	~Leaderboard() noexcept;
+
+	bool Open();
+	void Add(const LeaderboardEntry& entry);
+	// Both return how many entries were written to out, best score first
+	int GetTop(LeaderboardEntry* out, int maxCount);
+	int GetBySeed(uint64_t seed, LeaderboardEntry* out, int maxCount);
+	int64_t GetCount() const;
+private:
+	struct IndexHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t count;
+		uint64_t coveredLogBytes;	// Length of the log prefix folded into this index
+	};
+	static constexpr uint32_t magic = 0x5844494C;	// "LIDX"
+	static constexpr uint32_t version = 1;
+
+	struct Index
+	{
+		MappedFile file;
+		const LeaderboardEntry* byScore = nullptr;
+		const LeaderboardEntry* bySeed = nullptr;
+		uint64_t count = 0;
+		uint64_t coveredLogBytes = 0;
+	};
+
+	static bool IsBetter(const LeaderboardEntry& a, const LeaderboardEntry& b);
+	static bool SeedOrder(const LeaderboardEntry& a, const LeaderboardEntry& b);
+	static bool WriteIndex(const std::string& path, const Index* oldIndex, std::vector<LeaderboardEntry> tail, uint64_t coveredLogBytes);
+	std::unique_ptr<Index> LoadIndex() const;
+	bool LoadTail(uint64_t fromLogBytes);
+	void StartCompaction();
+	void FinishCompaction();
+private:
+	const std::string logPath;
+	const std::string indexPath;
+	std::unique_ptr<Index> index;
+	std::vector<LeaderboardEntry> tail;	// Sorted best first
+	uint64_t logBytes = 0;
+
+	std::atomic<bool> isCompacting = false;
+	std::atomic<bool> isCompactionDone = false;
+	bool isCompactionSuccessful = false;
+	uint64_t compactingLogBytes = 0;
+#ifndef PLATFORM_WEB
+	std::thread compactionThread;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "MappedFile.h"
+#include <assert.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() noexcept
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path, size_t size)
+{
+	assert(!IsOpen() && size > 0);
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	const size_t mappedSize = std::max(size, static_cast<size_t>(fileSize.QuadPart));
+
+	// Mapping a file with a larger size grows it on disk
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(mappedSize) >> 32), static_cast<DWORD>(mappedSize), nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappedSize);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<uint8_t*>(view);
+	this->size = mappedSize;
+	isReadOnly = false;
+	return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string& path)
+{
+	assert(!IsOpen());
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	isReadOnly = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!IsOpen())
+		return;
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+void MappedFile::Flush(bool async)
+{
+	if (!IsOpen() || isReadOnly)
+		return;
+	FlushViewOfFile(data, size);
+	if (!async)
+	{
+		FlushFileBuffers(fileHandle);
+	}
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path, size_t size)
+{
+	assert(!IsOpen() && size > 0);
+	int file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (file < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(file, &st) != 0)
+	{
+		close(file);
+		return false;
+	}
+	size_t mappedSize = static_cast<size_t>(st.st_size);
+	if (mappedSize < size)
+	{
+		if (ftruncate(file, static_cast<off_t>(size)) != 0)
+		{
+			close(file);
+			return false;
+		}
+		mappedSize = size;
+	}
+
+	void* view = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (view == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+
+	fd = file;
+	data = static_cast<uint8_t*>(view);
+	this->size = mappedSize;
+	isReadOnly = false;
+	return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string& path)
+{
+	assert(!IsOpen());
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(file, &st) != 0 || st.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+	if (view == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+
+	fd = file;
+	data = static_cast<uint8_t*>(view);
+	size = static_cast<size_t>(st.st_size);
+	isReadOnly = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!IsOpen())
+		return;
+	munmap(data, size);
+	close(fd);
+	data = nullptr;
+	size = 0;
+	fd = -1;
+}
+
+void MappedFile::Flush(bool async)
+{
+	if (!IsOpen() || isReadOnly)
+		return;
+	msync(data, size, async ? MS_ASYNC : MS_SYNC);
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return data != nullptr;
+}
+
+uint8_t* MappedFile::GetData()
+{
+	assert(!isReadOnly);
+	return data;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory mapping of a whole file. Writes through GetData() land in the OS page cache
+// straight away and survive a crash of the process without any explicit write call.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() noexcept;
+
+	// Creates the file if needed and grows it to at least size bytes
+	bool Open(const std::string& path, size_t size);
+	bool OpenReadOnly(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+	void Flush(bool async);
+
+	uint8_t* GetData();
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+private:
+	uint8_t* data = nullptr;
+	size_t size = 0;
+	bool isReadOnly = false;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "OpeningBook.h"
+#include "Zobrist.h"
+
+uint64_t OpeningBook::MakeKey(const uint32_t* rows, int height, PieceType type, PieceType next)
+{
+	uint64_t key = zobrist::PieceKey(type, 0, 0, 0) ^ zobrist::PreviewKey(next, 0);
+	for (int y = 0; y < height; ++y)
+	{
+		key ^= zobrist::RowKey(y, rows[y]);
+	}
+	return key;
+}
+
+bool OpeningBook::Open(const std::string& path, int width, int height)
+{
+	if (!file.OpenReadOnly(path))
+		return false;
+
+	const uint8_t* data = static_cast<const MappedFile&>(file).GetData();
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+	const bool isValid = file.GetSize() >= sizeof(FileHeader) && header->magic == magic && header->version == version &&
+		header->width == static_cast<uint32_t>(width) && header->height == static_cast<uint32_t>(height) &&
+		header->entryCount > 0 && header->entryCount <= (file.GetSize() - sizeof(FileHeader)) / sizeof(Entry);
+	if (!isValid)
+	{
+		file.Close();
+		return false;
+	}
+	entries = reinterpret_cast<const Entry*>(data + sizeof(FileHeader));
+	entryCount = header->entryCount;
+	return true;
+}
+
+bool OpeningBook::IsOpen() const
+{
+	return entries != nullptr;
+}
+
+bool OpeningBook::Find(uint64_t key, PathPlanner::Placement& placement) const
+{
+	if (!IsOpen())
+		return false;
+
+	// Halving the range with a conditional move instead of a branch, the last entry
+	// left is the only one that can match
+	const Entry* base = entries;
+	for (uint64_t n = entryCount; n > 1; n -= n / 2)
+	{
+		base = base[n / 2].key <= key ? base + n / 2 : base;
+	}
+	if (base->key != key)
+		return false;
+	placement = { base->x, base->y, base->rotation };
+	return true;
+}
+
+uint64_t OpeningBook::GetEntryCount() const
+{
+	return entryCount;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Pieces.h"
+#include "PathPlanner.h"
+#include "MappedFile.h"
+
+// Precomputed best placements for early game positions, looked up before searching
+// live. The file is a header followed by entries sorted by key, mapped read-only and
+// searched in place with a binary search whose only branch is the loop itself. Keys
+// are Zobrist hashes of the board, the falling piece and the next piece, so they are
+// spread evenly. Built by OpeningBookBuilder.
+class OpeningBook
+{
+public:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t entryCount;
+		uint32_t width;
+		uint32_t height;
+		uint32_t plies;
+		uint32_t reserved;
+	};
+	struct Entry
+	{
+		uint64_t key;
+		int8_t x;
+		int8_t y;
+		uint8_t rotation;
+		uint8_t reserved[5];
+	};
+	static constexpr uint32_t magic = 0x4B4F4F42;	// "BOOK"
+	static constexpr uint32_t version = 1;	// Searches and rule changes bump it too
+public:
+	// rows as for PathPlanner
+	static uint64_t MakeKey(const uint32_t* rows, int height, PieceType type, PieceType next);
+
+	// False if there is no book or it was built for another board size
+	bool Open(const std::string& path, int width, int height);
+	bool IsOpen() const;
+	// The book's placement for the position, false when it doesn't have one
+	bool Find(uint64_t key, PathPlanner::Placement& placement) const;
+	uint64_t GetEntryCount() const;
+private:
+	MappedFile file;
+	const Entry* entries = nullptr;
+	uint64_t entryCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "OpeningBookBuilder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <unordered_set>
+#include <assert.h>
+#include "Heuristics.h"
+#include "MappedFile.h"
+
+namespace
+{
+	constexpr int64_t topOutValue = std::numeric_limits<int32_t>::min();
+	constexpr int pieceTypeCount = static_cast<int>(PieceType::Count);
+}
+
+bool OpeningBookBuilder::Build(const std::string& path, int plies, int threadCount)
+{
+	assert(plies >= 1 && threadCount >= 1);
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	entries.clear();
+	positions.clear();
+	std::unordered_set<uint64_t> known;
+	for (int t = 0; t < pieceTypeCount; ++t)
+	{
+		for (int n = 0; n < pieceTypeCount; ++n)
+		{
+			Position& position = positions.emplace_back();
+			position.rows.fill(0);
+			position.type = static_cast<PieceType>(t);
+			position.next = static_cast<PieceType>(n);
+			position.key = OpeningBook::MakeKey(position.rows.data(), height, position.type, position.next);
+			known.insert(position.key);
+		}
+	}
+
+	for (int ply = 0; ply < plies && !positions.empty(); ++ply)
+	{
+		results.assign(positions.size(), {});
+		nextPosition = 0;
+		std::vector<std::thread> threads;
+		for (int i = 1; i < threadCount; ++i)
+		{
+			threads.emplace_back([this, &workers, i]() { RunWorker(*workers[i]); });
+		}
+		RunWorker(*workers[0]);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		// Play the book's move in every position, the piece after the next one can be any
+		std::vector<Position> nextPositions;
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			const Position& position = positions[i];
+			const Result& result = results[i];
+			if (!result.isFound)
+				continue;
+			OpeningBook::Entry& entry = entries.emplace_back();
+			entry = {};
+			entry.key = position.key;
+			entry.x = static_cast<int8_t>(result.placement.x);
+			entry.y = static_cast<int8_t>(result.placement.y);
+			entry.rotation = static_cast<uint8_t>(result.placement.rotation);
+
+			std::array<uint32_t, height> rows = position.rows;
+			heuristics::ApplyPlacement(rows.data(), width, height, position.type, result.placement);
+			if (rows[0] != 0)
+				continue;
+			for (int n = 0; n < pieceTypeCount; ++n)
+			{
+				Position next = { 0, rows, position.next, static_cast<PieceType>(n) };
+				next.key = OpeningBook::MakeKey(next.rows.data(), height, next.type, next.next);
+				if (known.insert(next.key).second)
+				{
+					nextPositions.push_back(next);
+				}
+			}
+		}
+		std::printf("Ply %d: %d positions searched\n", ply + 1, static_cast<int>(positions.size()));
+		positions.swap(nextPositions);
+	}
+
+	return WriteBook(path, plies);
+}
+
+uint64_t OpeningBookBuilder::GetEntryCount() const
+{
+	return entries.size();
+}
+
+void OpeningBookBuilder::RunWorker(Worker& worker)
+{
+	for (size_t i = nextPosition++; i < positions.size(); i = nextPosition++)
+	{
+		results[i] = SearchPosition(worker, positions[i]);
+	}
+}
+
+OpeningBookBuilder::Result OpeningBookBuilder::SearchPosition(Worker& worker, const Position& position) const
+{
+	PathPlanner& planner = worker.planners[0];
+	const PathPlanner::Placement spawn = { pieces::SpawnX(position.type, width), 0, 0 };
+	if (!planner.Search(position.rows.data(), width, height, position.type, spawn))
+		return { false, {} };
+
+	Result result = { false, {} };
+	int64_t bestValue = 0;
+	std::array<uint32_t, height> rows;
+	for (int p = 0; p < planner.GetPlacementCount(); ++p)
+	{
+		rows = position.rows;
+		const int cleared = heuristics::ApplyPlacement(rows.data(), width, height, position.type, planner.GetPlacement(p));
+		const int64_t value = rows[0] != 0 ? topOutValue : Lookahead(worker, position, rows.data(), cleared, 1);
+		if (!result.isFound || value > bestValue)
+		{
+			result = { true, planner.GetPlacement(p) };
+			bestValue = value;
+		}
+	}
+	return result;
+}
+
+int64_t OpeningBookBuilder::Lookahead(Worker& worker, const Position& position, const uint32_t* rows, int cleared, int level) const
+{
+	if (level == searchDepth)
+		return heuristics::ScoreBoard(rows, width, height, cleared);
+
+	// The next piece is known, the one after it could be any. Sum rather than average
+	// over those, siblings are only compared with each other.
+	PathPlanner& planner = worker.planners[level];
+	const int firstType = level == 1 ? static_cast<int>(position.next) : 0;
+	const int lastType = level == 1 ? firstType : pieceTypeCount - 1;
+	std::array<uint32_t, height> next;
+	int64_t total = 0;
+	for (int t = firstType; t <= lastType; ++t)
+	{
+		const PieceType type = static_cast<PieceType>(t);
+		const PathPlanner::Placement spawn = { pieces::SpawnX(type, width), 0, 0 };
+		int64_t best = topOutValue;
+		if (planner.Search(rows, width, height, type, spawn))
+		{
+			for (int p = 0; p < planner.GetPlacementCount(); ++p)
+			{
+				std::copy_n(rows, height, next.begin());
+				const int nextCleared = heuristics::ApplyPlacement(next.data(), width, height, type, planner.GetPlacement(p));
+				if (next[0] != 0)
+					continue;
+				best = std::max(best, Lookahead(worker, position, next.data(), cleared + nextCleared, level + 1));
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+bool OpeningBookBuilder::WriteBook(const std::string& path, int plies)
+{
+	std::sort(entries.begin(), entries.end(),
+		[](const OpeningBook::Entry& a, const OpeningBook::Entry& b) { return a.key < b.key; });
+
+	// Mapping only ever grows a file, an older and larger book would leave its tail behind
+	std::remove(path.c_str());
+	MappedFile file;
+	const size_t size = sizeof(OpeningBook::FileHeader) + entries.size() * sizeof(OpeningBook::Entry);
+	if (entries.empty() || !file.Open(path, size))
+		return false;
+
+	const OpeningBook::FileHeader header = { OpeningBook::magic, OpeningBook::version, entries.size(),
+		width, height, static_cast<uint32_t>(plies), 0 };
+	std::memcpy(file.GetData(), &header, sizeof(header));
+	std::memcpy(file.GetData() + sizeof(header), entries.data(), entries.size() * sizeof(OpeningBook::Entry));
+	file.Flush(false);
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Pieces.h"
+#include "PathPlanner.h"
+#include "OpeningBook.h"
+#include "VecEnv.h"
+
+// Offline search tool for the opening book. Starting from the empty board with every
+// pair of falling and next piece, it searches each position for its best placement,
+// plays that placement and adds every possible new next piece, ply by ply. Positions
+// already in the book are not searched again. A placement is scored by the best
+// follow-up with the known next piece and the expected best move with the unknown
+// piece after it, far deeper than bots can afford per piece.
+class OpeningBookBuilder
+{
+public:
+	static constexpr int width = VecEnv::width;
+	static constexpr int height = VecEnv::height;
+public:
+	// Positions of one ply are searched on threadCount threads. False if the file can't be written.
+	bool Build(const std::string& path, int plies, int threadCount);
+	uint64_t GetEntryCount() const;
+private:
+	static constexpr int searchDepth = 3;
+	struct Position
+	{
+		uint64_t key;
+		std::array<uint32_t, height> rows;
+		PieceType type;
+		PieceType next;
+	};
+	struct Result
+	{
+		bool isFound;
+		PathPlanner::Placement placement;
+	};
+	// One planner per piece deep
+	struct Worker
+	{
+		std::array<PathPlanner, searchDepth> planners;
+	};
+
+	void RunWorker(Worker& worker);
+	Result SearchPosition(Worker& worker, const Position& position) const;
+	// Value of the board once the pieces from level on are placed, the known next piece
+	// at level 1 and the expected best unknown one after it
+	int64_t Lookahead(Worker& worker, const Position& position, const uint32_t* rows, int cleared, int level) const;
+	bool WriteBook(const std::string& path, int plies);
+private:
+	std::vector<Position> positions;	// The ply being searched
+	std::vector<Result> results;
+	std::atomic<size_t> nextPosition = 0;
+	std::vector<OpeningBook::Entry> entries;
+};
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "ParticleSystem.h"
+#include "Settings.h"
+#include <rlgl.h>
+#include <assert.h>
+#include <algorithm>
+
+ParticleSystem::ParticleSystem(int capacity)
+	: capacity(capacity)
+{
+	assert(capacity > 0);
+	// All storage is allocated once here, emitting never allocates
+	posX.resize(capacity);
+	posY.resize(capacity);
+	velX.resize(capacity);
+	velY.resize(capacity);
+	life.resize(capacity);
+	invLifetime.resize(capacity);
+	colors.resize(capacity);
+}
+
+float ParticleSystem::RandomSigned()
+{
+	// xorshift32, plenty for visual noise and much cheaper than <random>
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return static_cast<float>(rngState & 0xFFFF) / 32767.5f - 1.0f;
+}
+
+void ParticleSystem::Emit(Vector2 origin, Color color, int count, float speed)
+{
+	// Purely cosmetic, a burst that doesn't fit in the queue is dropped
+	pendingBursts.Push({ origin, color, count, speed });
+}
+
+void ParticleSystem::Spawn(const Burst& burst)
+{
+	// When the pool is full new particles are dropped rather than evicting old ones
+	const int toEmit = std::min(burst.count, capacity - count);
+	const float speed = burst.speed;
+	for (int n = 0; n < toEmit; ++n)
+	{
+		const int i = count++;
+		const float lifetime = settings::particleLifetime * (0.75f + 0.25f * RandomSigned());
+		posX[i] = burst.origin.x;
+		posY[i] = burst.origin.y;
+		velX[i] = RandomSigned() * speed;
+		velY[i] = RandomSigned() * speed - speed * 0.5f;
+		life[i] = lifetime;
+		invLifetime[i] = 1.0f / lifetime;
+		colors[i] = burst.color;
+	}
+}
+
+void ParticleSystem::Update(float deltaTime)
+{
+	Burst burst;
+	while (pendingBursts.Pop(burst))
+	{
+		Spawn(burst);
+	}
+
+	const float gravityStep = settings::particleGravity * deltaTime;
+	float* px = posX.data();
+	float* py = posY.data();
+	float* vx = velX.data();
+	float* vy = velY.data();
+	float* l = life.data();
+
+	// Branch-free integration over contiguous arrays so the compiler can vectorize it
+	for (int i = 0; i < count; ++i)
+	{
+		vy[i] += gravityStep;
+		px[i] += vx[i] * deltaTime;
+		py[i] += vy[i] * deltaTime;
+		l[i] -= deltaTime;
+	}
+
+	// Compact dead particles by moving the last live one into their slot
+	for (int i = 0; i < count;)
+	{
+		if (l[i] > 0.0f)
+		{
+			++i;
+			continue;
+		}
+		const int last = --count;
+		px[i] = px[last];
+		py[i] = py[last];
+		vx[i] = vx[last];
+		vy[i] = vy[last];
+		l[i] = l[last];
+		invLifetime[i] = invLifetime[last];
+		colors[i] = colors[last];
+	}
+}
+
+void ParticleSystem::Draw() const
+{
+	if (count == 0) return;
+
+	const float size = settings::particleSize;
+	// One immediate-mode batch for the whole pool instead of a DrawRectangle per particle
+	rlBegin(RL_QUADS);
+	for (int i = 0; i < count; ++i)
+	{
+		const Color c = colors[i];
+		const float fade = std::min(life[i] * invLifetime[i], 1.0f);
+		rlColor4ub(c.r, c.g, c.b, static_cast<unsigned char>(c.a * fade));
+		rlVertex2f(posX[i], posY[i]);
+		rlVertex2f(posX[i], posY[i] + size);
+		rlVertex2f(posX[i] + size, posY[i] + size);
+		rlVertex2f(posX[i] + size, posY[i]);
+	}
+	rlEnd();
+}
+
+void ParticleSystem::Clear()
+{
+	Burst burst;
+	while (pendingBursts.Pop(burst))
+	{
+	}
+	count = 0;
+}
+
+int ParticleSystem::GetCount() const
+{
+	return count;
+}
+
+bool ParticleSystem::IsEmpty() const
+{
+	return count == 0 && pendingBursts.IsEmpty();
+}
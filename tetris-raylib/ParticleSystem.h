@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "raylibCpp.h"
+#include "SpscQueue.h"
+
+// Fixed-capacity particle pool stored structure-of-arrays, so the update loop
+// runs over plain float arrays and the whole pool is drawn as one quad batch.
+// Emit only queues a burst, so the simulation thread can emit while the render
+// thread owns the pool, the bursts are spawned on the next Update.
+class ParticleSystem
+{
+public:
+	ParticleSystem(int capacity);
+	void Emit(Vector2 origin, Color color, int count, float speed);
+	void Update(float deltaTime);
+	void Draw() const;
+	void Clear();
+	int GetCount() const;
+	bool IsEmpty() const;
+private:
+	struct Burst
+	{
+		Vector2 origin;
+		Color color;
+		int count;
+		float speed;
+	};
+	void Spawn(const Burst& burst);
+	float RandomSigned();
+private:
+	const int capacity;
+	SpscQueue<Burst, 512> pendingBursts;
+	int count = 0;
+	uint32_t rngState = 0x9E3779B9u;
+
+	std::vector<float> posX;
+	std::vector<float> posY;
+	std::vector<float> velX;
+	std::vector<float> velY;
+	std::vector<float> life;
+	std::vector<float> invLifetime;
+	std::vector<Color> colors;
+};
@@ -0,0 +1,222 @@
+#include "PathPlanner.h"
+#include <algorithm>
+#include <cstdlib>
+#include <assert.h>
+
+namespace
+{
+	constexpr PathPlanner::Move searchMoves[] = {
+		PathPlanner::Move::Left,
+		PathPlanner::Move::Right,
+		PathPlanner::Move::RotateClockwise,
+		PathPlanner::Move::RotateCounterClockwise,
+		PathPlanner::Move::Down
+	};
+
+	uint32_t ShiftRow(uint32_t row, int x)
+	{
+		return x >= 0 ? row << x : row >> -x;
+	}
+}
+
+bool PathPlanner::Plan(const uint32_t* rows, int width, int height, PieceType type, Placement start, int targetX, int targetY)
+{
+	if (!Search(rows, width, height, type, start))
+		return false;
+
+	// Placements are in order of move count, so the first one at a given distance
+	// from the target is also the quickest to reach
+	int best = -1;
+	int bestDistance = 0;
+	for (int i = 0; i < placementCount; ++i)
+	{
+		const int distance = TargetDistance(placements[i], targetX, targetY);
+		if (distance >= 0 && (best < 0 || distance < bestDistance))
+		{
+			best = i;
+			bestDistance = distance;
+		}
+	}
+	return best >= 0 && BuildPath(best);
+}
+
+bool PathPlanner::Search(const uint32_t* rows, int width, int height, PieceType type, Placement start)
+{
+	assert(width <= maxWidth && height <= maxHeight);
+	this->rows = rows;
+	this->width = width;
+	this->height = height;
+	this->type = type;
+	moveCount = 0;
+	placementCount = 0;
+	if (!Fits(start.x, start.y, start.rotation))
+		return false;
+
+	std::fill(parents.begin(), parents.end(), unvisited);
+	startIndex = StateIndex(start.x, start.y, start.rotation);
+	parents[startIndex] = static_cast<int16_t>(startIndex);
+	queue[0] = static_cast<int16_t>(startIndex);
+	int head = 0;
+	int tail = 1;
+
+	while (head < tail)
+	{
+		const int index = queue[head++];
+		const Placement p = StateAt(index);
+
+		if (!Fits(p.x, p.y + 1, p.rotation))
+		{
+			restingStates[placementCount] = static_cast<int16_t>(index);
+			placements[placementCount++] = p;
+		}
+
+		for (Move move : searchMoves)
+		{
+			Placement next = p;
+			bool isLegal = false;
+			switch (move)
+			{
+			case Move::Left:
+				--next.x;
+				isLegal = Fits(next.x, next.y, next.rotation);
+				break;
+			case Move::Right:
+				++next.x;
+				isLegal = Fits(next.x, next.y, next.rotation);
+				break;
+			case Move::Down:
+				++next.y;
+				isLegal = Fits(next.x, next.y, next.rotation);
+				break;
+			case Move::RotateClockwise:
+			case Move::RotateCounterClockwise:
+			{
+				// The first free kick wins, exactly as Tetromino rotates
+				const int turn = move == Move::RotateClockwise ? 1 : pieces::rotationCount - 1;
+				next.rotation = (p.rotation + turn) % pieces::rotationCount;
+				const pieces::KickList& kicks = pieces::GetKicks(type, p.rotation, next.rotation);
+				for (int k = 0; k < kicks.count && !isLegal; ++k)
+				{
+					next.x = p.x + kicks.kicks[k].x;
+					next.y = p.y + kicks.kicks[k].y;
+					isLegal = Fits(next.x, next.y, next.rotation);
+				}
+				break;
+			}
+			}
+			if (!isLegal)
+				continue;
+
+			const int nextIndex = StateIndex(next.x, next.y, next.rotation);
+			if (parents[nextIndex] != unvisited)
+				continue;
+			parents[nextIndex] = static_cast<int16_t>(index);
+			parentMoves[nextIndex] = move;
+			queue[tail++] = static_cast<int16_t>(nextIndex);
+		}
+	}
+	return true;
+}
+
+int PathPlanner::GetPlacementCount() const
+{
+	return placementCount;
+}
+
+const PathPlanner::Placement& PathPlanner::GetPlacement(int i) const
+{
+	assert(i >= 0 && i < placementCount);
+	return placements[i];
+}
+
+int PathPlanner::FindPlacement(const Placement& placement) const
+{
+	for (int i = 0; i < placementCount; ++i)
+	{
+		const Placement& p = placements[i];
+		if (p.x == placement.x && p.y == placement.y && p.rotation == placement.rotation)
+			return i;
+	}
+	return -1;
+}
+
+bool PathPlanner::BuildPath(int placement)
+{
+	assert(placement >= 0 && placement < placementCount);
+	const int targetIndex = restingStates[placement];
+	int length = 0;
+	for (int index = targetIndex; index != startIndex; index = parents[index])
+	{
+		++length;
+	}
+	if (length > maxPathLength)
+		return false;
+
+	moveCount = length;
+	for (int index = targetIndex, i = length - 1; index != startIndex; index = parents[index], --i)
+	{
+		path[i] = parentMoves[index];
+	}
+	target = placements[placement];
+	return true;
+}
+
+const PathPlanner::Placement& PathPlanner::GetTarget() const
+{
+	return target;
+}
+
+int PathPlanner::GetMoveCount() const
+{
+	return moveCount;
+}
+
+PathPlanner::Move PathPlanner::GetMove(int i) const
+{
+	assert(i >= 0 && i < moveCount);
+	return path[i];
+}
+
+bool PathPlanner::Fits(int x, int y, int rotation) const
+{
+	const pieces::Footprint& f = pieces::GetFootprint(type, rotation);
+	if (x + f.minX < 0 || x + f.maxX >= width || y + f.minY < 0 || y + f.maxY >= height)
+		return false;
+
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		if (rows[y + r] & ShiftRow(f.rows[r], x))
+			return false;
+	}
+	return true;
+}
+
+int PathPlanner::StateIndex(int x, int y, int rotation) const
+{
+	return rotation * statesPerRotation + (y + margin) * (maxWidth + margin) + (x + margin);
+}
+
+PathPlanner::Placement PathPlanner::StateAt(int index) const
+{
+	const int cell = index % statesPerRotation;
+	return { cell % (maxWidth + margin) - margin, cell / (maxWidth + margin) - margin, index / statesPerRotation };
+}
+
+int PathPlanner::TargetDistance(const Placement& placement, int targetX, int targetY) const
+{
+	const pieces::Footprint& f = pieces::GetFootprint(type, placement.rotation);
+	const int column = targetX - placement.x;
+	if (column < f.minX || column > f.maxX)
+		return -1;
+
+	int distance = -1;
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		if ((f.rows[r] >> column) & 1u)
+		{
+			const int d = std::abs(placement.y + r - targetY);
+			distance = distance < 0 ? d : std::min(distance, d);
+		}
+	}
+	return distance;
+}
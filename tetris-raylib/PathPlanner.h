@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "Pieces.h"
+
+// Finds the shortest sequence of moves that takes the falling piece to a resting
+// placement, using only the moves and wall kicks a player has. The search is a
+// breadth first search over (x, y, rotation) in fixed size arrays, a few thousand
+// states at most, so it finishes well within a tick and never allocates.
+class PathPlanner
+{
+public:
+	enum class Move : uint8_t
+	{
+		Left,
+		Right,
+		RotateClockwise,
+		RotateCounterClockwise,
+		Down
+	};
+	struct Placement
+	{
+		int x;	// Of the piece box, like Tetromino positions
+		int y;
+		int rotation;	// Clockwise quarter turns, 0 to 3
+	};
+	static constexpr int maxWidth = 16;
+	static constexpr int maxHeight = 32;
+	static constexpr int maxPathLength = 48;
+public:
+	// rows holds one bitmask per board row, bit x set for a settled cell, row 0 on top.
+	// Picks the resting placement that covers the target cell, or failing that the one
+	// closest to it in the target column, with the fewest moves. False if no resting
+	// placement reaches the target column.
+	bool Plan(const uint32_t* rows, int width, int height, PieceType type, Placement start, int targetX, int targetY);
+
+	// The two halves of Plan for callers that choose the placement themselves. Search
+	// finds every reachable resting placement, in order of move count, BuildPath then
+	// makes one of them the target.
+	bool Search(const uint32_t* rows, int width, int height, PieceType type, Placement start);
+	int GetPlacementCount() const;
+	const Placement& GetPlacement(int i) const;
+	// Index of a placement found by the last Search, -1 if it isn't reachable
+	int FindPlacement(const Placement& placement) const;
+	bool BuildPath(int placement);
+
+	const Placement& GetTarget() const;
+	int GetMoveCount() const;
+	Move GetMove(int i) const;
+private:
+	static constexpr int margin = pieces::maxDimension - 1;	// Box cells may hang off the left and top edge
+	static constexpr int statesPerRotation = (maxWidth + margin) * (maxHeight + margin);
+	static constexpr int stateCount = statesPerRotation * pieces::rotationCount;
+	static constexpr int16_t unvisited = -1;
+
+	bool Fits(int x, int y, int rotation) const;
+	int StateIndex(int x, int y, int rotation) const;
+	Placement StateAt(int index) const;
+	// Distance from the target to the placement's nearest cell in the target column, -1 if it has none there
+	int TargetDistance(const Placement& placement, int targetX, int targetY) const;
+private:
+	const uint32_t* rows = nullptr;
+	int width = 0;
+	int height = 0;
+	PieceType type = PieceType::Straight;
+
+	std::array<int16_t, stateCount> parents;
+	std::array<Move, stateCount> parentMoves;
+	std::array<int16_t, stateCount> queue;
+	int startIndex = 0;
+	std::array<int16_t, stateCount> restingStates;
+	std::array<Placement, stateCount> placements;
+	int placementCount = 0;
+
+	Placement target = {};
+	std::array<Move, maxPathLength> path;
+	int moveCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include "PerfectClearSolver.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <assert.h>
+#include "Zobrist.h"
+
+namespace
+{
+	constexpr int cellsPerPiece = 4;
+	// Empty rows kept above the stack for the placement search, enough for any piece to
+	// turn freely, so the placements it finds are the same as on the whole board
+	constexpr int headroom = pieces::maxDimension + 1;
+	constexpr uint32_t evenColumns = 0x55555555u;
+
+	uint32_t ShiftRow(uint32_t row, int x)
+	{
+		return x >= 0 ? row << x : row >> -x;
+	}
+
+	int CountCells(uint32_t row)
+	{
+		int count = 0;
+		for (; row != 0; row &= row - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+
+	// Cells in even columns minus cells in odd columns
+	int GetColumnParity(uint32_t row)
+	{
+		return CountCells(row & evenColumns) - CountCells(row & ~evenColumns);
+	}
+
+	// Most a piece can move the column parity of the board, in any rotation
+	int GetParityChange(PieceType type)
+	{
+		int most = 0;
+		for (int rotation = 0; rotation < pieces::rotationCount; ++rotation)
+		{
+			const pieces::Footprint& f = pieces::GetFootprint(type, rotation);
+			int change = 0;
+			for (int r = f.minY; r <= f.maxY; ++r)
+			{
+				change += GetColumnParity(f.rows[r]);
+			}
+			most = std::max(most, std::abs(change));
+		}
+		return most;
+	}
+
+	uint64_t HashRows(const uint32_t* rows, int height)
+	{
+		uint64_t hash = 0;
+		for (int y = 0; y < height; ++y)
+		{
+			hash ^= zobrist::RowKey(y, rows[y]);
+		}
+		return hash;
+	}
+}
+
+PerfectClearSolver::PerfectClearSolver()
+	:
+	memo(std::make_unique<std::atomic<uint64_t>[]>(size_t(1) << memoBits))
+{
+}
+
+bool PerfectClearSolver::Solve(const uint32_t* rows, int width, int height, const PieceType* queue, int pieceCount, int threadCount)
+{
+	assert(width > 0 && width <= PathPlanner::maxWidth && height > 0 && height <= maxHeight);
+	assert(pieceCount >= 0 && pieceCount <= maxPieces);
+	assert(threadCount >= 1);
+	const auto startTime = std::chrono::steady_clock::now();
+	this->width = width;
+	this->height = height;
+	this->pieceCount = pieceCount;
+	fullRowMask = (1u << width) - 1;
+	std::copy(queue, queue + pieceCount, this->queue.begin());
+	parityReach[pieceCount] = 0;
+	for (int i = pieceCount - 1; i >= 0; --i)
+	{
+		parityReach[i] = parityReach[i + 1] + GetParityChange(queue[i]);
+	}
+
+	for (size_t i = 0; i < size_t(1) << memoBits; ++i)
+	{
+		memo[i].store(0, std::memory_order_relaxed);
+	}
+	while (static_cast<int>(workers.size()) < threadCount)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+	for (const std::unique_ptr<Worker>& worker : workers)
+	{
+		worker->nodeCount = 0;
+	}
+	solutionLength = 0;
+
+	Position start = {};
+	start.cellCount = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		start.rows[y] = rows[y] & fullRowMask;
+		start.cellCount += CountCells(start.rows[y]);
+	}
+	start.hash = HashRows(start.rows.data(), height);
+
+	tasks.clear();
+	GenerateTasks(*workers[0], start, 0);
+	nextTask = 0;
+	solvedTask = noTask;
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back([this, i]() { RunWorker(*workers[i]); });
+	}
+	RunWorker(*workers[0]);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	nodeCount = 0;
+	for (const std::unique_ptr<Worker>& worker : workers)
+	{
+		nodeCount += worker->nodeCount;
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return solvedTask != noTask;
+}
+
+bool PerfectClearSolver::ParseRows(const std::string& text, int width, int height, uint32_t* rows)
+{
+	std::fill_n(rows, height, 0u);
+	if (text.empty())
+		return true;
+
+	const int rowCount = static_cast<int>(std::count(text.begin(), text.end(), '/')) + 1;
+	if (rowCount > height || static_cast<int>(text.size()) != rowCount * (width + 1) - 1)
+		return false;
+	for (int r = 0; r < rowCount; ++r)
+	{
+		const char* cells = text.c_str() + r * (width + 1);
+		if (r + 1 < rowCount && cells[width] != '/')
+			return false;
+		uint32_t& row = rows[height - rowCount + r];
+		for (int x = 0; x < width; ++x)
+		{
+			if (cells[x] == '/')
+				return false;
+			row |= static_cast<uint32_t>(cells[x] != '.') << x;
+		}
+	}
+	return true;
+}
+
+int PerfectClearSolver::GetStepCount() const
+{
+	return solutionLength;
+}
+
+const PerfectClearSolver::Step& PerfectClearSolver::GetStep(int i) const
+{
+	assert(i >= 0 && i < solutionLength);
+	return solution[i];
+}
+
+uint64_t PerfectClearSolver::GetNodeCount() const
+{
+	return nodeCount;
+}
+
+double PerfectClearSolver::GetSeconds() const
+{
+	return seconds;
+}
+
+void PerfectClearSolver::GenerateTasks(Worker& worker, const Position& position, int depth)
+{
+	// An empty board only counts once a piece has been placed, the start may be empty too
+	if (depth == splitDepth || depth == pieceCount || (depth > 0 && position.cellCount == 0))
+	{
+		Task& task = tasks.emplace_back();
+		task.position = position;
+		std::copy(worker.steps.begin(), worker.steps.begin() + depth, task.steps.begin());
+		task.depth = depth;
+		return;
+	}
+	++worker.nodeCount;
+	if (IsDead(position, depth))
+		return;
+
+	Expand(worker, position, depth);
+	for (const Candidate& candidate : worker.candidates[depth])
+	{
+		worker.steps[depth] = candidate.step;
+		GenerateTasks(worker, candidate.position, depth + 1);
+	}
+}
+
+void PerfectClearSolver::RunWorker(Worker& worker)
+{
+	for (;;)
+	{
+		const int i = nextTask.fetch_add(1);
+		if (i >= static_cast<int>(tasks.size()) || i > solvedTask.load())
+			return;
+
+		const Task& task = tasks[i];
+		worker.task = i;
+		std::copy(task.steps.begin(), task.steps.begin() + task.depth, worker.steps.begin());
+		if (!Search(worker, task.position, task.depth))
+			continue;
+
+		// Later tasks may finish first, the earliest one's solution is kept
+		std::lock_guard<std::mutex> lock(solutionMutex);
+		if (i < solvedTask.load())
+		{
+			solvedTask = i;
+			solutionLength = worker.solutionLength;
+			std::copy(worker.steps.begin(), worker.steps.begin() + solutionLength, solution.begin());
+		}
+	}
+}
+
+bool PerfectClearSolver::Search(Worker& worker, const Position& position, int depth)
+{
+	++worker.nodeCount;
+	if (depth > 0 && position.cellCount == 0)
+	{
+		worker.solutionLength = depth;
+		return true;
+	}
+	if (depth == pieceCount || IsDead(position, depth))
+		return false;
+	// An earlier task is already solved, nothing this one finds would be used
+	if (solvedTask.load(std::memory_order_relaxed) < worker.task)
+		return false;
+
+	const uint64_t key = GetMemoKey(position, depth);
+	if (IsKnownDead(key))
+		return false;
+
+	Expand(worker, position, depth);
+	for (const Candidate& candidate : worker.candidates[depth])
+	{
+		worker.steps[depth] = candidate.step;
+		if (Search(worker, candidate.position, depth + 1))
+			return true;
+	}
+
+	// An abandoned search proves nothing
+	if (solvedTask.load(std::memory_order_relaxed) > worker.task)
+	{
+		AddKnownDead(key);
+	}
+	return false;
+}
+
+void PerfectClearSolver::Expand(Worker& worker, const Position& position, int depth)
+{
+	std::vector<Candidate>& candidates = worker.candidates[depth];
+	candidates.clear();
+	const PieceType type = queue[depth];
+	const PathPlanner::Placement spawn = { pieces::SpawnX(type, width), 0, 0 };
+
+	// The rows high above the stack are empty and only make the search longer
+	int top = 0;
+	while (top < height && position.rows[top] == 0)
+	{
+		++top;
+	}
+	top = std::max(0, top - headroom);
+	if (!worker.planner.Search(position.rows.data() + top, width, height - top, type, spawn))
+		return;
+
+	for (int i = 0; i < worker.planner.GetPlacementCount(); ++i)
+	{
+		PathPlanner::Placement placement = worker.planner.GetPlacement(i);
+		placement.y += top;
+		Candidate candidate;
+		candidate.step = { type, placement };
+		Position& next = candidate.position;
+		next.rows = position.rows;
+
+		const pieces::Footprint& f = pieces::GetFootprint(type, placement.rotation);
+		for (int r = f.minY; r <= f.maxY; ++r)
+		{
+			next.rows[placement.y + r] |= ShiftRow(f.rows[r], placement.x);
+		}
+
+		// Full rows clear and the rows above drop, as on the Board
+		int to = height - 1;
+		for (int y = height - 1; y >= 0; --y)
+		{
+			if (next.rows[y] != fullRowMask)
+			{
+				next.rows[to--] = next.rows[y];
+			}
+		}
+		const int cleared = to + 1;
+		for (; to >= 0; --to)
+		{
+			next.rows[to] = 0;
+		}
+
+		// Locking into the top row ends the game
+		if (next.rows[0] != 0)
+			continue;
+
+		next.cellCount = position.cellCount + cellsPerPiece - cleared * width;
+		next.hash = HashRows(next.rows.data(), height);
+
+		// Different placements often leave the same board
+		const auto isSame = [&next](const Candidate& c) {
+			return c.position.hash == next.hash && c.position.rows == next.rows;
+		};
+		if (std::none_of(candidates.begin(), candidates.end(), isSame))
+		{
+			candidates.push_back(candidate);
+		}
+	}
+
+	// Boards with fewer cells are closer to a clear, try them first
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b) { return a.position.cellCount < b.position.cellCount; });
+}
+
+bool PerfectClearSolver::IsDead(const Position& position, int depth) const
+{
+	// The board only empties once its cells and the pieces placed fill whole rows.
+	// Find the most rows the remaining pieces could fill that way.
+	int lines = 0;
+	for (int n = pieceCount - depth; n > 0 && lines == 0; --n)
+	{
+		const int cells = position.cellCount + n * cellsPerPiece;
+		if (cells % width == 0)
+		{
+			lines = cells / width;
+		}
+	}
+	if (lines == 0)
+		return true;
+
+	// Every occupied row has to be among them
+	int occupiedRows = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		occupiedRows += position.rows[y] != 0;
+	}
+	if (occupiedRows > lines)
+		return true;
+
+	// A full row of even width has as many cells in even columns as in odd ones, so
+	// the pieces have to make up any difference before the board can be empty
+	if (width % 2 == 0)
+	{
+		int parity = 0;
+		for (int y = 0; y < height; ++y)
+		{
+			parity += GetColumnParity(position.rows[y]);
+		}
+		if (std::abs(parity) > parityReach[depth])
+			return true;
+	}
+
+	return HasSealedHoles(position);
+}
+
+bool PerfectClearSolver::HasSealedHoles(const Position& position) const
+{
+	// Empty cells that a piece entering from the top could get to, through other empty cells
+	std::array<uint32_t, maxHeight> reachable = {};
+	bool isGrowing = true;
+	while (isGrowing)
+	{
+		isGrowing = false;
+		for (int y = 0; y < height; ++y)
+		{
+			const uint32_t empty = ~position.rows[y] & fullRowMask;
+			uint32_t reach = reachable[y] | (y == 0 ? fullRowMask : reachable[y - 1]);
+			reach |= y + 1 < height ? reachable[y + 1] : 0;
+			reach &= empty;
+			for (uint32_t spread = reach; ; reach = spread)
+			{
+				spread = (reach | reach << 1 | reach >> 1) & empty;
+				if (spread == reach)
+					break;
+			}
+			if (reach != reachable[y])
+			{
+				reachable[y] = reach;
+				isGrowing = true;
+			}
+		}
+	}
+
+	// A sealed hole only opens once a row next to it clears. If every such row holds
+	// sealed cells itself, none of them can ever fill up and the holes stay sealed.
+	bool hasSealed = false;
+	for (int y = 0; y < height; ++y)
+	{
+		const uint32_t sealed = ~position.rows[y] & fullRowMask & ~reachable[y];
+		if (sealed == 0)
+			continue;
+		hasSealed = true;
+		const bool isRoofClearable = y > 0 && (position.rows[y - 1] & sealed) && (position.rows[y - 1] | reachable[y - 1]) == fullRowMask;
+		const bool isFloorClearable = y + 1 < height && (position.rows[y + 1] & sealed) && (position.rows[y + 1] | reachable[y + 1]) == fullRowMask;
+		if (isRoofClearable || isFloorClearable)
+			return false;
+	}
+	return hasSealed;
+}
+
+uint64_t PerfectClearSolver::GetMemoKey(const Position& position, int depth) const
+{
+	// The depth decides the rest of the queue, so it is part of the state
+	const uint64_t key = position.hash ^ zobrist::Mix(static_cast<uint64_t>(depth) + 1);
+	return key == 0 ? 1 : key;
+}
+
+bool PerfectClearSolver::IsKnownDead(uint64_t key) const
+{
+	return memo[key & ((size_t(1) << memoBits) - 1)].load(std::memory_order_relaxed) == key;
+}
+
+void PerfectClearSolver::AddKnownDead(uint64_t key)
+{
+	memo[key & ((size_t(1) << memoBits) - 1)].store(key, std::memory_order_relaxed);
+}
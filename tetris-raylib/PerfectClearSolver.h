@@ -0,0 +1,113 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Pieces.h"
+#include "PathPlanner.h"
+
+// Finds placements for the pieces of a known queue that leave the board empty, or
+// proves that none do, for generating perfect clear puzzles. Only placements the
+// PathPlanner reaches from the spawn are tried, so every solution can be played with
+// the game's own moves and kicks. Dead ends are cut by counting cells, by column
+// parity and by holes that can never be opened, and boards already proven unsolvable
+// at the same point in the queue are remembered in a table shared by all threads.
+//
+// The first placements split the search into tasks that the threads take in order.
+// The solution from the earliest task wins, so the result is the same for any
+// thread count. Desktop only.
+class PerfectClearSolver
+{
+public:
+	struct Step
+	{
+		PieceType type;
+		PathPlanner::Placement placement;
+	};
+	static constexpr int maxPieces = 16;
+	static constexpr int maxHeight = PathPlanner::maxHeight;
+public:
+	PerfectClearSolver();
+	PerfectClearSolver(const PerfectClearSolver&) = delete;
+	PerfectClearSolver& operator=(const PerfectClearSolver&) = delete;
+
+	// A setup as text, rows top to bottom ending on the floor and separated by '/', '.'
+	// for an empty cell and anything else for a filled one, like "XXXX..XXXX/XXX...XXXX".
+	// Fills height rows, the ones above the setup empty. False on a malformed setup.
+	static bool ParseRows(const std::string& text, int width, int height, uint32_t* rows);
+
+	// rows as for PathPlanner, queue[0] is the current piece. True if placing at most
+	// pieceCount pieces of the queue, in order, empties the board. False is a proof
+	// that no placements do.
+	bool Solve(const uint32_t* rows, int width, int height, const PieceType* queue, int pieceCount, int threadCount);
+	int GetStepCount() const;
+	const Step& GetStep(int i) const;
+	// Positions searched by the last Solve, across all threads
+	uint64_t GetNodeCount() const;
+	double GetSeconds() const;
+private:
+	static constexpr int splitDepth = 2;
+	static constexpr int memoBits = 20;
+	static constexpr int noTask = INT32_MAX;
+
+	struct Position
+	{
+		std::array<uint32_t, maxHeight> rows;	// Rows past height stay empty
+		uint64_t hash;
+		int cellCount;
+	};
+	struct Candidate
+	{
+		Position position;
+		Step step;
+	};
+	struct Task
+	{
+		Position position;
+		std::array<Step, splitDepth> steps;
+		int depth;
+	};
+	struct Worker
+	{
+		PathPlanner planner;
+		std::array<std::vector<Candidate>, maxPieces> candidates;
+		std::array<Step, maxPieces> steps;
+		uint64_t nodeCount = 0;
+		int task = 0;
+		int solutionLength = 0;
+	};
+
+	void GenerateTasks(Worker& worker, const Position& position, int depth);
+	void RunWorker(Worker& worker);
+	bool Search(Worker& worker, const Position& position, int depth);
+	// Fills the worker's candidates for the piece at depth with every distinct board it can leave
+	void Expand(Worker& worker, const Position& position, int depth);
+	bool IsDead(const Position& position, int depth) const;
+	bool HasSealedHoles(const Position& position) const;
+	uint64_t GetMemoKey(const Position& position, int depth) const;
+	bool IsKnownDead(uint64_t key) const;
+	void AddKnownDead(uint64_t key);
+private:
+	int width = 0;
+	int height = 0;
+	uint32_t fullRowMask = 0;
+	std::array<PieceType, maxPieces> queue;
+	int pieceCount = 0;
+	// Largest column parity change the pieces from each depth on can still make
+	std::array<int, maxPieces + 1> parityReach;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<Task> tasks;
+	std::atomic<int> nextTask = 0;
+	std::atomic<int> solvedTask = noTask;
+	std::unique_ptr<std::atomic<uint64_t>[]> memo;
+
+	std::mutex solutionMutex;
+	std::array<Step, maxPieces> solution;
+	int solutionLength = 0;
+	uint64_t nodeCount = 0;
+	double seconds = 0.0;
+};
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "Perft.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <assert.h>
+
+namespace
+{
+	constexpr char pieceLetters[] = "IOTJLSZ";
+	static_assert(sizeof(pieceLetters) - 1 == static_cast<int>(PieceType::Count));
+	constexpr size_t nodesPerGrab = 16;
+
+	size_t CountDistinct(std::vector<uint64_t>& hashes)
+	{
+		std::sort(hashes.begin(), hashes.end());
+		return std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+	}
+}
+
+Perft::Worker::Worker()
+	:
+	board(settings::boardPosition, settings::boardWidthHeight, settings::cellSize, settings::boardPadding),
+	visited(stateCount)
+{
+}
+
+bool Perft::ParseQueue(const std::string& letters, std::vector<PieceType>& queue)
+{
+	queue.clear();
+	for (char letter : letters)
+	{
+		const char* found = std::find(pieceLetters, pieceLetters + sizeof(pieceLetters) - 1, letter);
+		if (*found == '\0' || static_cast<int>(queue.size()) == maxDepth)
+			return false;
+		queue.push_back(static_cast<PieceType>(found - pieceLetters));
+	}
+	return !queue.empty();
+}
+
+void Perft::Run(const PieceType* queue, int depth, int threadCount)
+{
+	assert(depth >= 1 && depth <= maxDepth && threadCount >= 1);
+	const auto start = std::chrono::steady_clock::now();
+	while (static_cast<int>(workers.size()) < threadCount)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	counts.fill({});
+	level.assign(1, Node{ 0, {}, false });
+	counts[0].boards = 1;
+	for (int d = 1; d <= depth; ++d)
+	{
+		const bool isLastDepth = d == depth;
+		nextNode = 0;
+		std::vector<std::thread> threads;
+		for (int i = 1; i < threadCount; ++i)
+		{
+			threads.emplace_back([this, i, queue, d, isLastDepth]() { RunWorker(*workers[i], queue[d - 1], isLastDepth); });
+		}
+		RunWorker(*workers[0], queue[d - 1], isLastDepth);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		DepthCount& count = counts[d];
+		std::vector<uint64_t> hashes;
+		std::vector<uint64_t> toppedOut;
+		std::vector<Node> next;
+		for (int i = 0; i < threadCount; ++i)
+		{
+			Worker& worker = *workers[i];
+			count.placements += worker.placements;
+			hashes.insert(hashes.end(), worker.foundHashes.begin(), worker.foundHashes.end());
+			toppedOut.insert(toppedOut.end(), worker.toppedOutHashes.begin(), worker.toppedOutHashes.end());
+			next.insert(next.end(), worker.found.begin(), worker.found.end());
+			worker.placements = 0;
+			worker.foundHashes.clear();
+			worker.toppedOutHashes.clear();
+			worker.found.clear();
+		}
+		if (isLastDepth)
+		{
+			count.boards = CountDistinct(hashes);
+			count.toppedOut = CountDistinct(toppedOut);
+			break;
+		}
+
+		std::sort(next.begin(), next.end(), [](const Node& a, const Node& b) { return a.hash < b.hash; });
+		next.erase(std::unique(next.begin(), next.end(), [](const Node& a, const Node& b) { return a.hash == b.hash; }), next.end());
+		count.boards = next.size();
+		for (const Node& node : next)
+		{
+			count.toppedOut += node.isToppedOut;
+		}
+		// Games that ended stay counted but go no further
+		next.erase(std::remove_if(next.begin(), next.end(), [](const Node& node) { return node.isToppedOut; }), next.end());
+		level.swap(next);
+	}
+	level.clear();
+	level.shrink_to_fit();
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const Perft::DepthCount& Perft::GetCount(int depth) const
+{
+	assert(depth >= 0 && depth <= maxDepth);
+	return counts[depth];
+}
+
+double Perft::GetSeconds() const
+{
+	return seconds;
+}
+
+void Perft::RunWorker(Worker& worker, PieceType type, bool isLastDepth)
+{
+	for (size_t first = nextNode.fetch_add(nodesPerGrab); first < level.size(); first = nextNode.fetch_add(nodesPerGrab))
+	{
+		const size_t last = std::min(level.size(), first + nodesPerGrab);
+		for (size_t i = first; i < last; ++i)
+		{
+			ExpandBoard(worker, level[i].rows, type, isLastDepth);
+		}
+	}
+}
+
+void Perft::ExpandBoard(Worker& worker, const Rows& rows, PieceType type, bool isLastDepth)
+{
+	Board& board = worker.board;
+	RestoreBoard(board, rows);
+	Tetromino piece(type, board);
+
+	std::fill(worker.visited.begin(), worker.visited.end(), uint8_t(0));
+	worker.queue.clear();
+	const Tetromino::State spawn = piece.GetState();
+	worker.visited[StateIndex(spawn)] = 1;
+	worker.queue.push_back(spawn);
+
+	// The moves a player has, each one tried from every position reached so far
+	using Move = void (Tetromino::*)();
+	constexpr Move moves[] = { &Tetromino::MoveLeft, &Tetromino::MoveRight, &Tetromino::RotateClockwise,
+		&Tetromino::RotateCounterClockwise, &Tetromino::Drop };
+	for (size_t q = 0; q < worker.queue.size(); ++q)
+	{
+		const Tetromino::State state = worker.queue[q];
+		for (Move move : moves)
+		{
+			piece.SetState(state);
+			(piece.*move)();
+			const Tetromino::State next = piece.GetState();
+			uint8_t& isVisited = worker.visited[StateIndex(next)];
+			if (!isVisited)
+			{
+				isVisited = 1;
+				worker.queue.push_back(next);
+			}
+		}
+
+		// Resting where a drop doesn't move it, gravity would lock it there
+		piece.SetState(state);
+		piece.Drop();
+		if (!(piece.GetState().pos == state.pos))
+			continue;
+
+		piece.SetState(state);
+		piece.AddToBoard();
+		board.Update();
+		++worker.placements;
+		const bool isToppedOut = board.IsTopRowOccupied();
+		if (isLastDepth)
+		{
+			worker.foundHashes.push_back(board.GetHash());
+			if (isToppedOut)
+			{
+				worker.toppedOutHashes.push_back(board.GetHash());
+			}
+		}
+		else
+		{
+			Node& node = worker.found.emplace_back();
+			node.hash = board.GetHash();
+			node.isToppedOut = isToppedOut;
+			for (int y = 0; y < height; ++y)
+			{
+				node.rows[y] = static_cast<Board::RowMask>(board.GetRowMask(y));
+			}
+		}
+		RestoreBoard(board, rows);
+	}
+}
+
+void Perft::RestoreBoard(Board& board, const Rows& rows)
+{
+	board.Reset();
+	for (int y = 0; y < height; ++y)
+	{
+		for (uint32_t mask = rows[y]; mask != 0; mask &= mask - 1)
+		{
+			int x = 0;
+			while (!((mask >> x) & 1u))
+			{
+				++x;
+			}
+			board.SetCell({ x, y }, WHITE);
+		}
+	}
+}
+
+int Perft::StateIndex(const Tetromino::State& state)
+{
+	const int x = state.pos.GetX() + margin;
+	const int y = state.pos.GetY() + margin;
+	assert(x >= 0 && x < width + 2 * margin && y >= 0 && y < height + 2 * margin);
+	return ((static_cast<int>(state.rotation) / 90 * (height + 2 * margin)) + y) * (width + 2 * margin) + x;
+}
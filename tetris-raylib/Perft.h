@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Board.h"
+#include "Tetromino.h"
+#include "Pieces.h"
+
+// Counts the boards reachable by placing the pieces of a fixed queue, like a chess
+// perft. Each piece is moved by Tetromino itself on a real Board, breadth first over
+// every position its moves, kicks and drops reach from the spawn. Every position it
+// can't drop from is locked and full rows are cleared the way Simulation does it.
+// Boards are told apart by the Board's own Zobrist hash and each distinct board is
+// expanded once. A board with its top row occupied has ended the game and is not
+// expanded. The counts for a queue never change, so they cross-check any change to
+// movement, kicks or collisions, and the run time benchmarks them. Desktop only.
+class Perft
+{
+public:
+	static constexpr int maxDepth = 16;
+	struct DepthCount
+	{
+		uint64_t placements;	// Locks tried from the boards of the depth before
+		uint64_t boards;	// Distinct boards after them
+		uint64_t toppedOut;	// Of those boards
+	};
+public:
+	// Pieces by letter, IOTJLSZ. False on any other letter or more than maxDepth pieces.
+	static bool ParseQueue(const std::string& letters, std::vector<PieceType>& queue);
+
+	// Places queue[0] to queue[depth - 1] on an empty board
+	void Run(const PieceType* queue, int depth, int threadCount);
+	const DepthCount& GetCount(int depth) const;
+	// Of the whole run, for nodes per second
+	double GetSeconds() const;
+private:
+	static constexpr int width = settings::boardWidthHeight.GetX();
+	static constexpr int height = settings::boardWidthHeight.GetY();
+	// Piece boxes may hang off the board while moving, by less than their size
+	static constexpr int margin = pieces::maxDimension;
+	static constexpr int stateCount = (width + 2 * margin) * (height + 2 * margin) * pieces::rotationCount;
+	using Rows = std::array<Board::RowMask, height>;
+	struct Node
+	{
+		uint64_t hash;
+		Rows rows;
+		bool isToppedOut;
+	};
+	struct Worker
+	{
+		Worker();
+		Board board;
+		std::vector<uint8_t> visited;
+		std::vector<Tetromino::State> queue;
+		std::vector<Node> found;
+		// At the last depth only the hashes are kept, the boards aren't expanded
+		std::vector<uint64_t> foundHashes;
+		std::vector<uint64_t> toppedOutHashes;
+		uint64_t placements = 0;
+	};
+
+	void RunWorker(Worker& worker, PieceType type, bool isLastDepth);
+	void ExpandBoard(Worker& worker, const Rows& rows, PieceType type, bool isLastDepth);
+	static void RestoreBoard(Board& board, const Rows& rows);
+	static int StateIndex(const Tetromino::State& state);
+private:
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<Node> level;	// Distinct boards still in the game at the current depth
+	std::atomic<size_t> nextNode = 0;
+	std::array<DepthCount, maxDepth + 1> counts = {};
+	double seconds = 0.0;
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "Persistence.h"
+
+#ifdef PLATFORM_WEB
+#include <emscripten/emscripten.h>
+#endif
+
+void persistence::Mount()
+{
+#ifdef PLATFORM_WEB
+	static bool isMounted = false;
+	if (isMounted)
+		return;
+	isMounted = true;
+
+	// IDBFS loads asynchronously, wait for it before anything is opened
+	EM_ASM({
+		FS.mkdir('/save');
+		FS.mount(IDBFS, {}, '/save');
+		Module.persistenceLoaded = false;
+		FS.syncfs(true, function(err) { Module.persistenceLoaded = true; });
+	});
+	while (!EM_ASM_INT({ return Module.persistenceLoaded ? 1 : 0; }))
+	{
+		emscripten_sleep(10);
+	}
+#endif
+}
+
+void persistence::Sync()
+{
+#ifdef PLATFORM_WEB
+	// Overlapping syncs are not allowed, one asked for meanwhile runs after the current one
+	EM_ASM({
+		if (Module.persistenceSyncing) {
+			Module.persistencePending = true;
+			return;
+		}
+		function sync() {
+			Module.persistenceSyncing = true;
+			Module.persistencePending = false;
+			FS.syncfs(false, function(err) {
+				Module.persistenceSyncing = false;
+				if (Module.persistencePending) {
+					sync();
+				}
+			});
+		}
+		sync();
+	});
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Saved files of the browser build live in /save, an in-memory file system that only
+// persists once it is synced to IndexedDB. Everything written there has to be synced,
+// a closed tab loses what wasn't. The desktop build writes to disk and these do nothing.
+namespace persistence
+{
+	// Loads the saved files, blocks until they are there. Call before opening any of them.
+	void Mount();
+	// Copies the files back to IndexedDB without blocking. A sync asked for while one
+	// is running starts when it is done, so the last write is never left behind.
+	void Sync();
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "Pieces.h"
+
+void PieceRandomizer::Seed(uint64_t seed)
+{
+	state = seed;
+}
+
+PieceType PieceRandomizer::Next()
+{
+	// splitmix64
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+	// Map the top 32 bits onto [0, Count) with a multiply instead of a modulo
+	const uint64_t count = static_cast<uint64_t>(PieceType::Count);
+	return static_cast<PieceType>(((z >> 32) * count) >> 32);
+}
+
+uint64_t PieceRandomizer::GetState() const
+{
+	return state;
+}
+
+void PieceRandomizer::SetState(uint64_t state)
+{
+	this->state = state;
+}
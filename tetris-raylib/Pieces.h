@@ -0,0 +1,230 @@
+#pragma once
+#include <cstdint>
+
+// Piece definitions and the piece sequence, shared by Tetromino and the headless
+// environment. Nothing here depends on raylib.
+enum class PieceType : uint8_t
+{
+	Straight,
+	Square,
+	Tee,
+	Jay,
+	Ell,
+	SkewS,
+	SkewZ,
+	Count
+};
+
+// Seeded piece sequence with a single 64 bit word of state, so a game can be
+// saved and replayed exactly
+class PieceRandomizer
+{
+public:
+	void Seed(uint64_t seed);
+	PieceType Next();
+	uint64_t GetState() const;
+	void SetState(uint64_t state);
+private:
+	uint64_t state = 0;
+};
+
+namespace pieces
+{
+	constexpr int rotationCount = 4;
+	constexpr int maxDimension = 4;
+
+	// Spawn orientation, row by row, in a dimension x dimension box
+	struct Shape
+	{
+		int dimension;
+		bool cells[maxDimension * maxDimension];
+	};
+
+	inline constexpr Shape shapes[] =
+	{
+		{ 4, { 0,0,0,0,
+			1,1,1,1,
+			0,0,0,0,
+			0,0,0,0 } },	// Straight
+		{ 2, { 1,1,
+			1,1 } },	// Square
+		{ 3, { 0,1,0,
+			1,1,1,
+			0,0,0 } },	// Tee
+		{ 3, { 1,0,0,
+			1,1,1,
+			0,0,0 } },	// Jay
+		{ 3, { 0,0,1,
+			1,1,1,
+			0,0,0 } },	// Ell
+		{ 3, { 0,1,1,
+			1,1,0,
+			0,0,0 } },	// SkewS
+		{ 3, { 1,1,0,
+			0,1,1,
+			0,0,0 } },	// SkewZ
+	};
+	static_assert(sizeof(shapes) / sizeof(shapes[0]) == static_cast<int>(PieceType::Count));
+
+	// Whether the box cell (x, y) is filled with the shape turned clockwise rotation times
+	constexpr bool IsCellAt(const Shape& shape, int rotation, int x, int y)
+	{
+		const int d = shape.dimension;
+		switch (rotation) {
+		case 0: return shape.cells[y * d + x];
+		case 1: return shape.cells[d * (d - 1) - d * x + y];
+		case 2: return shape.cells[d * (d - y) - (x + 1)];
+		case 3: return shape.cells[(d - 1) + d * x - y];
+		default: return false;
+		}
+	}
+
+	// One rotation of a piece as a row bitmask per box row plus the filled extent,
+	// so collision against board row masks is a shift and an and per row
+	struct Footprint
+	{
+		uint32_t rows[maxDimension];
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+	};
+
+	constexpr Footprint MakeFootprint(const Shape& shape, int rotation)
+	{
+		Footprint f = { { 0, 0, 0, 0 }, maxDimension, -1, maxDimension, -1 };
+		for (int y = 0; y < shape.dimension; ++y) {
+			for (int x = 0; x < shape.dimension; ++x) {
+				if (!IsCellAt(shape, rotation, x, y))
+					continue;
+				f.rows[y] |= 1u << x;
+				f.minX = x < f.minX ? x : f.minX;
+				f.maxX = x > f.maxX ? x : f.maxX;
+				f.minY = y < f.minY ? y : f.minY;
+				f.maxY = y > f.maxY ? y : f.maxY;
+			}
+		}
+		return f;
+	}
+
+	struct FootprintTable
+	{
+		Footprint entries[static_cast<int>(PieceType::Count)][rotationCount];
+	};
+
+	constexpr FootprintTable MakeFootprintTable()
+	{
+		FootprintTable table = {};
+		for (int type = 0; type < static_cast<int>(PieceType::Count); ++type) {
+			for (int rotation = 0; rotation < rotationCount; ++rotation) {
+				table.entries[type][rotation] = MakeFootprint(shapes[type], rotation);
+			}
+		}
+		return table;
+	}
+
+	inline constexpr FootprintTable footprints = MakeFootprintTable();
+	static_assert(footprints.entries[static_cast<int>(PieceType::Straight)][1].rows[3] == 0x4);
+	static_assert(footprints.entries[static_cast<int>(PieceType::Tee)][0].rows[0] == 0x2);
+
+	// Offsets tried in order when a rotation collides, the first free one wins
+	struct Kick
+	{
+		int x;
+		int y;
+	};
+
+	constexpr int maxKicks = 5;
+
+	struct KickList
+	{
+		int count;
+		Kick kicks[maxKicks];
+	};
+
+	// SRS wall kicks as usually published, y pointing up, for the clockwise turns
+	// 0->R, R->2, 2->L and L->0. Turning back counterclockwise tries the same offsets
+	// negated. The shapes above rotate about the centre of their box like SRS does,
+	// so the tables apply unchanged.
+	inline constexpr Kick srsKicks[rotationCount][maxKicks] =
+	{
+		{ { 0, 0 }, { -1, 0 }, { -1, 1 }, { 0, -2 }, { -1, -2 } },
+		{ { 0, 0 }, { 1, 0 }, { 1, -1 }, { 0, 2 }, { 1, 2 } },
+		{ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, -2 }, { 1, -2 } },
+		{ { 0, 0 }, { -1, 0 }, { -1, -1 }, { 0, 2 }, { -1, 2 } },
+	};
+	inline constexpr Kick srsStraightKicks[rotationCount][maxKicks] =
+	{
+		{ { 0, 0 }, { -2, 0 }, { 1, 0 }, { -2, -1 }, { 1, 2 } },
+		{ { 0, 0 }, { -1, 0 }, { 2, 0 }, { -1, 2 }, { 2, -1 } },
+		{ { 0, 0 }, { 2, 0 }, { -1, 0 }, { 2, 1 }, { -1, -2 } },
+		{ { 0, 0 }, { 1, 0 }, { -2, 0 }, { 1, -2 }, { -2, 1 } },
+	};
+
+	// Kick lists for every piece and every (from, to) rotation pair, in board
+	// coordinates. The square never kicks, and half turns aren't a move, so those
+	// entries only hold the unkicked position.
+	struct KickTable
+	{
+		KickList entries[static_cast<int>(PieceType::Count)][rotationCount][rotationCount];
+	};
+
+	constexpr KickTable MakeKickTable()
+	{
+		KickTable table = {};
+		for (int type = 0; type < static_cast<int>(PieceType::Count); ++type) {
+			for (int from = 0; from < rotationCount; ++from) {
+				for (int to = 0; to < rotationCount; ++to) {
+					KickList& list = table.entries[type][from][to];
+					list.count = 1;
+					list.kicks[0] = { 0, 0 };
+					if (static_cast<PieceType>(type) == PieceType::Square)
+						continue;
+
+					const Kick(&source)[rotationCount][maxKicks] =
+						static_cast<PieceType>(type) == PieceType::Straight ? srsStraightKicks : srsKicks;
+					const bool isClockwise = to == (from + 1) % rotationCount;
+					const bool isCounterClockwise = from == (to + 1) % rotationCount;
+					if (!isClockwise && !isCounterClockwise)
+						continue;
+
+					const Kick* kicks = source[isClockwise ? from : to];
+					const int sign = isClockwise ? 1 : -1;
+					list.count = maxKicks;
+					for (int i = 0; i < maxKicks; ++i) {
+						list.kicks[i] = { sign * kicks[i].x, -sign * kicks[i].y };
+					}
+				}
+			}
+		}
+		return table;
+	}
+
+	inline constexpr KickTable kickTable = MakeKickTable();
+	static_assert(kickTable.entries[static_cast<int>(PieceType::Tee)][0][1].kicks[2].x == -1 &&
+		kickTable.entries[static_cast<int>(PieceType::Tee)][0][1].kicks[2].y == -1);
+	static_assert(kickTable.entries[static_cast<int>(PieceType::Jay)][1][0].kicks[3].y == -2);
+	static_assert(kickTable.entries[static_cast<int>(PieceType::Straight)][0][3].kicks[1].x == -1);
+	static_assert(kickTable.entries[static_cast<int>(PieceType::Square)][0][1].count == 1);
+
+	constexpr const Shape& GetShape(PieceType type)
+	{
+		return shapes[static_cast<int>(type)];
+	}
+
+	constexpr const Footprint& GetFootprint(PieceType type, int rotation)
+	{
+		return footprints.entries[static_cast<int>(type)][rotation];
+	}
+
+	constexpr const KickList& GetKicks(PieceType type, int from, int to)
+	{
+		return kickTable.entries[static_cast<int>(type)][from][to];
+	}
+
+	// Pieces spawn centred at the top in their spawn orientation
+	constexpr int SpawnX(PieceType type, int boardWidth)
+	{
+		return boardWidth / 2 - GetShape(type).dimension / 2;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "Replay.h"
+#include "AllocationTracker.h"
+#include "Persistence.h"
+#include <algorithm>
+#include <cstring>
+#include <assert.h>
+
+ReplayWriter::~ReplayWriter() noexcept
+{
+	Close();
+}
+
+bool ReplayWriter::Open(const std::string& path, int keyframeInterval)
+{
+	assert(keyframeInterval > 0);
+	Close();
+	file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	const replay::FileHeader header = { replay::fileMagic, replay::version, keyframeInterval, 0 };
+	std::fwrite(&header, sizeof(header), 1, file);
+	offset = sizeof(header);
+	lastTick = 0;
+	this->keyframeInterval = keyframeInterval;
+	index.clear();
+	index.reserve(replay::reservedKeyframes);
+	return true;
+}
+
+bool ReplayWriter::IsOpen() const
+{
+	return file != nullptr;
+}
+
+void ReplayWriter::Close()
+{
+	if (!file)
+		return;
+
+	const replay::Trailer trailer = { offset, static_cast<uint32_t>(index.size()), lastTick, replay::trailerMagic };
+	if (!index.empty())
+	{
+		std::fwrite(index.data(), sizeof(replay::IndexEntry), index.size(), file);
+	}
+	std::fwrite(&trailer, sizeof(trailer), 1, file);
+	std::fclose(file);
+	file = nullptr;
+	// Without the trailer the replay can't be opened
+	persistence::Sync();
+}
+
+void ReplayWriter::WriteVarint(uint32_t value)
+{
+	uint8_t bytes[5];
+	int count = 0;
+	do
+	{
+		bytes[count] = static_cast<uint8_t>(value & 0x7F);
+		value >>= 7;
+		bytes[count++] |= value ? 0x80 : 0;
+	} while (value);
+	std::fwrite(bytes, 1, count, file);
+	offset += count;
+}
+
+void ReplayWriter::WriteTickDelta(int32_t tick, bool isKeyframe)
+{
+	assert(tick >= lastTick);	// Records are written in tick order
+	WriteVarint(static_cast<uint32_t>(tick - lastTick) << 1 | (isKeyframe ? 1 : 0));
+	lastTick = tick;
+}
+
+void ReplayWriter::AddInput(int32_t tick, const uint8_t* commands, int count)
+{
+	if (!file || count <= 0)
+		return;
+	WriteTickDelta(tick, false);
+	WriteVarint(static_cast<uint32_t>(count));
+	std::fwrite(commands, 1, count, file);
+	offset += count;
+}
+
+void ReplayWriter::AddKeyframe(const GameSnapshot& snapshot)
+{
+	if (!file)
+		return;
+	{
+		// Only grows past the reserved capacity in very long games
+		AllocationScope allocationScope(AllocationTag::Recording);
+		index.push_back({ snapshot.elapsedTicks, offset });
+	}
+	WriteTickDelta(snapshot.elapsedTicks, true);
+	std::fwrite(&snapshot, sizeof(snapshot), 1, file);
+	offset += sizeof(snapshot);
+}
+
+bool ReplayWriter::IsKeyframeDue(int32_t tick) const
+{
+	return file && tick % keyframeInterval == 0;
+}
+
+bool ReplayReader::Open(const std::string& path)
+{
+	Close();
+	if (!file.OpenReadOnly(path) || file.GetSize() < sizeof(replay::FileHeader))
+	{
+		file.Close();
+		return false;
+	}
+
+	replay::FileHeader header;
+	std::memcpy(&header, GetData(), sizeof(header));
+	if (header.magic != replay::fileMagic || header.version != replay::version)
+	{
+		file.Close();
+		return false;
+	}
+
+	if (!ReadTrailer())
+	{
+		ScanIndex();
+	}
+	if (index.empty())
+	{
+		// Nothing to start playing from
+		Close();
+		return false;
+	}
+	cursor = index.front().offset;
+	cursorTick = index.front().tick;
+	return true;
+}
+
+bool ReplayReader::IsOpen() const
+{
+	return file.IsOpen();
+}
+
+void ReplayReader::Close()
+{
+	file.Close();
+	index.clear();
+	dataEnd = 0;
+	cursor = 0;
+	cursorTick = 0;
+	lastTick = 0;
+}
+
+int32_t ReplayReader::GetLastTick() const
+{
+	return lastTick;
+}
+
+int ReplayReader::GetKeyframeCount() const
+{
+	return static_cast<int>(index.size());
+}
+
+const uint8_t* ReplayReader::GetData() const
+{
+	// The mapping is read-only, always go through the const overload
+	return file.GetData();
+}
+
+bool ReplayReader::ReadVarint(uint32_t& offset, uint32_t& value) const
+{
+	value = 0;
+	const uint8_t* data = GetData();
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (offset >= dataEnd)
+			return false;
+		const uint8_t byte = data[offset++];
+		value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool ReplayReader::ReadTrailer()
+{
+	const size_t size = file.GetSize();
+	if (size < sizeof(replay::FileHeader) + sizeof(replay::Trailer))
+		return false;
+
+	replay::Trailer trailer;
+	std::memcpy(&trailer, GetData() + size - sizeof(trailer), sizeof(trailer));
+	const size_t indexBytes = static_cast<size_t>(trailer.keyframeCount) * sizeof(replay::IndexEntry);
+	if (trailer.magic != replay::trailerMagic || trailer.indexOffset < sizeof(replay::FileHeader) ||
+		trailer.indexOffset + indexBytes + sizeof(trailer) != size)
+		return false;
+
+	index.resize(trailer.keyframeCount);
+	if (indexBytes > 0)
+	{
+		std::memcpy(index.data(), GetData() + trailer.indexOffset, indexBytes);
+	}
+	dataEnd = trailer.indexOffset;
+	lastTick = trailer.lastTick;
+	return true;
+}
+
+void ReplayReader::ScanIndex()
+{
+	// Walk every record, stopping at the first one that was cut off
+	index.clear();
+	dataEnd = static_cast<uint32_t>(file.GetSize());
+	uint32_t offset = sizeof(replay::FileHeader);
+	int32_t tick = 0;
+	uint32_t validEnd = offset;
+	while (offset < dataEnd)
+	{
+		const uint32_t start = offset;
+		uint32_t header = 0;
+		if (!ReadVarint(offset, header))
+			break;
+		const int32_t recordTick = tick + static_cast<int32_t>(header >> 1);
+		if (header & 1)
+		{
+			if (dataEnd - offset < sizeof(GameSnapshot))
+				break;
+			index.push_back({ recordTick, start });
+			offset += sizeof(GameSnapshot);
+		}
+		else
+		{
+			uint32_t count = 0;
+			if (!ReadVarint(offset, count) || dataEnd - offset < count)
+				break;
+			offset += count;
+		}
+		tick = recordTick;
+		validEnd = offset;
+	}
+	dataEnd = validEnd;
+	lastTick = tick;
+}
+
+bool ReplayReader::SeekKeyframe(int32_t tick, GameSnapshot& snapshot)
+{
+	if (index.empty())
+		return false;
+
+	// Newest keyframe at or before tick, or the first one for ticks before it
+	auto it = std::upper_bound(index.begin(), index.end(), tick,
+		[](int32_t t, const replay::IndexEntry& entry) { return t < entry.tick; });
+	if (it != index.begin())
+	{
+		--it;
+	}
+
+	uint32_t offset = it->offset;
+	uint32_t header = 0;
+	if (!ReadVarint(offset, header) || (header & 1) == 0 || dataEnd - offset < sizeof(GameSnapshot))
+		return false;
+	std::memcpy(&snapshot, GetData() + offset, sizeof(snapshot));
+	cursor = offset + sizeof(GameSnapshot);
+	cursorTick = it->tick;
+	return true;
+}
+
+bool ReplayReader::ReadKeyframe(int32_t tick, GameSnapshot& snapshot) const
+{
+	auto it = std::lower_bound(index.begin(), index.end(), tick,
+		[](const replay::IndexEntry& entry, int32_t t) { return entry.tick < t; });
+	if (it == index.end() || it->tick != tick)
+		return false;
+
+	uint32_t offset = it->offset;
+	uint32_t header = 0;
+	if (!ReadVarint(offset, header) || (header & 1) == 0 || dataEnd - offset < sizeof(GameSnapshot))
+		return false;
+	std::memcpy(&snapshot, GetData() + offset, sizeof(snapshot));
+	return true;
+}
+
+bool ReplayReader::NextInput(Input& input)
+{
+	while (cursor < dataEnd)
+	{
+		uint32_t offset = cursor;
+		uint32_t header = 0;
+		if (!ReadVarint(offset, header))
+			return false;
+		const int32_t tick = cursorTick + static_cast<int32_t>(header >> 1);
+		if (header & 1)
+		{
+			if (dataEnd - offset < sizeof(GameSnapshot))
+				return false;
+			offset += sizeof(GameSnapshot);
+			cursor = offset;
+			cursorTick = tick;
+			continue;
+		}
+
+		uint32_t count = 0;
+		if (!ReadVarint(offset, count) || dataEnd - offset < count)
+			return false;
+		input = { tick, static_cast<int>(count), GetData() + offset };
+		cursor = offset + count;
+		cursorTick = tick;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "GameSnapshot.h"
+
+// Replay files hold a compact input stream with a full keyframe every few seconds
+// and an index of the keyframes at the end, so any tick can be reached by loading
+// the nearest keyframe and re-simulating only the ticks after it.
+//
+// Layout: FileHeader, then records, then the keyframe index and a Trailer.
+// Every record starts with a varint of (tick delta << 1 | isKeyframe). Input records
+// go on with a varint command count and the raw command bytes, keyframe records with
+// a GameSnapshot. A file without a valid trailer (the recording was cut off) is
+// still readable, the index is rebuilt by scanning the records.
+namespace replay
+{
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		int32_t keyframeInterval;	// In ticks
+		uint32_t reserved;
+	};
+	struct IndexEntry
+	{
+		int32_t tick;
+		uint32_t offset;	// Of the keyframe record
+	};
+	struct Trailer
+	{
+		uint32_t indexOffset;
+		uint32_t keyframeCount;
+		int32_t lastTick;
+		uint32_t magic;
+	};
+	inline constexpr uint32_t fileMagic = 0x4C505254;	// "TRPL"
+	inline constexpr uint32_t trailerMagic = 0x58444954;	// "TIDX"
+	inline constexpr uint32_t version = 2;	// Bumped whenever the rules change, old inputs would replay differently
+	// Index capacity reserved up front, enough for well over an hour of keyframes
+	// so recording doesn't allocate during play
+	inline constexpr int reservedKeyframes = 512;
+}
+
+class ReplayWriter
+{
+public:
+	ReplayWriter() = default;
+	ReplayWriter(const ReplayWriter&) = delete;
+	ReplayWriter& operator=(const ReplayWriter&) = delete;
+	~ReplayWriter() noexcept;
+
+	bool Open(const std::string& path, int keyframeInterval);
+	bool IsOpen() const;
+	// Writes the index, the file isn't touched again afterwards
+	void Close();
+
+	void AddInput(int32_t tick, const uint8_t* commands, int count);
+	void AddKeyframe(const GameSnapshot& snapshot);
+	bool IsKeyframeDue(int32_t tick) const;
+private:
+	void WriteVarint(uint32_t value);
+	void WriteTickDelta(int32_t tick, bool isKeyframe);
+private:
+	std::FILE* file = nullptr;
+	uint32_t offset = 0;
+	int32_t lastTick = 0;
+	int keyframeInterval = 0;
+	std::vector<replay::IndexEntry> index;
+};
+
+class ReplayReader
+{
+public:
+	struct Input
+	{
+		int32_t tick;
+		int count;
+		const uint8_t* commands;
+	};
+public:
+	bool Open(const std::string& path);
+	bool IsOpen() const;
+	void Close();
+
+	int32_t GetLastTick() const;
+	int GetKeyframeCount() const;
+	// Moves the cursor to the newest keyframe at or before tick and returns its state
+	bool SeekKeyframe(int32_t tick, GameSnapshot& snapshot);
+	// The keyframe recorded at exactly tick, without moving the cursor
+	bool ReadKeyframe(int32_t tick, GameSnapshot& snapshot) const;
+	// Next input record after the cursor, keyframes are skipped
+	bool NextInput(Input& input);
+private:
+	const uint8_t* GetData() const;
+	bool ReadVarint(uint32_t& offset, uint32_t& value) const;
+	bool ReadTrailer();
+	void ScanIndex();
+private:
+	MappedFile file;
+	std::vector<replay::IndexEntry> index;
+	uint32_t dataEnd = 0;	// Records end here, the index starts
+	uint32_t cursor = 0;
+	int32_t cursorTick = 0;
+	int32_t lastTick = 0;
+};
\ No newline at end of file
@@ -16,6 +16,9 @@ namespace settings
 	// Top: 60px for score area
 	constexpr int boardPosX = 60;
 	constexpr int boardPosY = 60;
+
+	// Keep the particle budget lower on phones
+	constexpr int maxParticles = 16384;
 #else
 	constexpr int screenWidth = 800;
 	constexpr int screenHeight = 600;
@@ -26,9 +29,12 @@ namespace settings
 	// Position to left side, leaving room for score on right
 	constexpr int boardPosX = 200;
 	constexpr int boardPosY = 50;
+
+	constexpr int maxParticles = 32768;
 #endif
 
 	inline constexpr int fps = 60;
+	inline constexpr double maxFrameTime = 0.25;
 	inline const std::string title = "Tetris";
 
 	// Board settings
@@ -37,6 +43,64 @@ namespace settings
 	inline constexpr Vec2<int> boardWidthHeight{ 10, 20 };
 
 	// Game settings
-	inline constexpr int initialDropInterval = 1;
-	inline constexpr float timeIntervalSpeedUp = 60.0f;
+	inline constexpr int initialLevel = 1;
+	inline constexpr int ticksPerSecond = 60;
+	inline constexpr double tickDuration = 1.0 / ticksPerSecond;
+	inline constexpr int ticksPerLevel = 60 * ticksPerSecond;
+
+	// Scoring, indexed by lines cleared at once and multiplied by the level
+	inline constexpr int lineClearScores[] = { 0, 100, 300, 500, 800 };
+
+	// Autosave, high scores and replays
+#ifdef PLATFORM_WEB
+	inline const std::string journalPath = "/save/autosave.journal";
+	inline const std::string leaderboardLogPath = "/save/leaderboard.log";
+	inline const std::string leaderboardIndexPath = "/save/leaderboard.idx";
+	inline const std::string replayPath = "/save/last.replay";
+#else
+	inline const std::string journalPath = "autosave.journal";
+	inline const std::string leaderboardLogPath = "leaderboard.log";
+	inline const std::string leaderboardIndexPath = "leaderboard.idx";
+	inline const std::string replayPath = "last.replay";
+#endif
+	inline constexpr int leaderboardCompactionThreshold = 64;
+	inline constexpr int locksPerCheckpoint = 8;
+	inline constexpr int journalFlushTicks = 2 * ticksPerSecond;
+
+	// Replays, seeking re-simulates at most one keyframe interval
+	inline constexpr int replayKeyframeTicks = 10 * ticksPerSecond;
+	inline constexpr int replaySeekShortTicks = 5 * ticksPerSecond;
+	inline constexpr int replaySeekLongTicks = 60 * ticksPerSecond;
+
+	// Spectator wall, a grid of bot games for watching a soak farm (desktop only)
+	inline constexpr int spectatorBoards = 256;
+	inline constexpr int spectatorMaxTicksPerFrame = 4;
+
+	// Training data export, headless bot games logged lock by lock (desktop only)
+	inline constexpr int exportPreviewPieces = 5;
+	inline constexpr int exportChunkRows = 1 << 16;
+	inline constexpr int exportMaxLocksPerGame = 1000;
+
+	// Opening book, the best placements for the first pieces of a game, built offline
+	// with --build-book. Every position the book's own moves reach within the plies is in it.
+	inline const std::string openingBookPath = "opening.book";
+	inline constexpr int openingBookPlies = 3;
+
+	// Input latency measurement, frames between synthetic inputs
+	inline constexpr int latencyInjectInterval = 4;
+
+	// Touch gestures
+	inline constexpr float swipeDistance = 30.0f;
+	inline constexpr double longPressTime = 0.4;
+	inline constexpr double tapTime = 0.25;
+	inline constexpr int touchGridCellSize = 40;
+
+	// Particle effects
+	inline constexpr float particleLifetime = 0.8f;
+	inline constexpr float particleGravity = 600.0f;
+	inline constexpr float particleSize = 3.0f;
+	inline constexpr float particleSpeed = 180.0f;
+	inline constexpr int lineClearParticlesPerCell = 24;
+	inline constexpr int lockParticlesPerCell = 6;
+	inline constexpr int topOutParticlesPerCell = 40;
 }
\ No newline at end of file
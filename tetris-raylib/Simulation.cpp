@@ -0,0 +1,619 @@
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "Simulation.h"
+#include "Settings.h"
+#include "Gravity.h"
+#include "Zobrist.h"
+#include "AllocationTracker.h"
+#include "LatencyTracker.h"
+
+Simulation::Simulation(ParticleSystem& particles, std::string recordPath, std::string watchPath)
+	: particles(particles),
+	board(settings::boardPosition, settings::boardWidthHeight, settings::cellSize, settings::boardPadding),
+	speedLevel(settings::initialLevel),
+	recordPath(std::move(recordPath)),
+	watchPath(std::move(watchPath))
+{
+}
+
+Simulation::~Simulation() noexcept
+{
+	Stop();
+	journal.Flush();
+	// Writes the index, so an unfinished game can still be scrubbed
+	recorder.Close();
+}
+
+bool Simulation::Open(const std::string& journalPath)
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+#ifndef PLATFORM_WEB
+	assert(!thread.joinable());	// Restoring touches all the state, do it before the thread starts
+#endif
+	if (!journal.Open(journalPath) || !RestoreFromJournal())
+		return false;
+	// The recording of the interrupted game is lost, record the rest from here
+	if (recorder.Open(recordPath, settings::replayKeyframeTicks))
+	{
+		GameSnapshot snapshot;
+		CaptureSnapshot(snapshot);
+		recorder.AddKeyframe(snapshot);
+	}
+	PublishFrame();
+	return true;
+}
+
+void Simulation::Start()
+{
+#ifndef PLATFORM_WEB
+	assert(!thread.joinable());
+	isStopping = false;
+	thread = std::thread(&Simulation::Run, this);
+#endif
+}
+
+void Simulation::Stop()
+{
+#ifndef PLATFORM_WEB
+	if (!thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		isStopping = true;
+	}
+	wakeSignal.notify_one();
+	thread.join();
+#endif
+}
+
+bool Simulation::Post(Command command)
+{
+	if (!commands.Push(command))
+		return false;
+	++postedCommands;
+#ifndef PLATFORM_WEB
+	// Taking the lock orders the push before the wait check, so the wakeup can't be missed
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wakeSignal.notify_one();
+#endif
+	return true;
+}
+
+bool Simulation::PostSeek(int32_t tick)
+{
+	seekTarget = tick;
+	return Post(Command::SeekReplay);
+}
+
+bool Simulation::PostPlace(int x, int y)
+{
+	placeTarget = (y << 16) | (x & 0xFFFF);
+	return Post(Command::Place);
+}
+
+uint32_t Simulation::GetPostedCount() const
+{
+	return postedCommands;
+}
+
+bool Simulation::FetchFrame()
+{
+	return frames.Fetch();
+}
+
+const Simulation::Frame& Simulation::GetFrame() const
+{
+	return frames.GetReadBuffer();
+}
+
+#ifndef PLATFORM_WEB
+void Simulation::Run()
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point last = Clock::now();
+	while (!isStopping)
+	{
+		const Clock::time_point now = Clock::now();
+		Update(std::chrono::duration<double>(now - last).count());
+		last = now;
+
+		// Sleep until the next tick is due, or indefinitely while nothing runs, a posted command wakes us early
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		const auto isWoken = [this] { return isStopping || !commands.IsEmpty(); };
+		if (isRunning)
+		{
+			const std::chrono::duration<double> untilTick(settings::tickDuration - tickAccumulator);
+			wakeSignal.wait_for(lock, untilTick, isWoken);
+		}
+		else
+		{
+			wakeSignal.wait(lock, isWoken);
+		}
+	}
+}
+#endif
+
+void Simulation::Update(double deltaTime)
+{
+	// Ticks must not allocate, session changes below override the tag
+	AllocationScope allocationScope(AllocationTag::Simulation);
+	// Time spent paused doesn't count towards the first ticks after resuming
+	const bool wasRunning = isRunning;
+	ProcessCommands();
+
+	if (isRunning)
+	{
+		// Run the simulation at a fixed tick rate, however irregularly we get called
+		if (wasRunning)
+		{
+			tickAccumulator += std::min(deltaTime, settings::maxFrameTime);
+		}
+		while (isRunning && tickAccumulator >= settings::tickDuration)
+		{
+			tickAccumulator -= settings::tickDuration;
+			if (isWatching)
+			{
+				StepReplay();
+			}
+			else
+			{
+				StepGameplay();
+			}
+		}
+	}
+
+	if (HasChanged())
+	{
+		PublishFrame();
+	}
+}
+
+uint64_t Simulation::GetStateHash() const
+{
+	if (!currentTetromino)
+		return 0;
+	return board.GetHash() ^ currentTetromino->GetHash() ^ zobrist::SequenceKey(randomizer.GetState());
+}
+
+void Simulation::ProcessCommands()
+{
+	Command command;
+	while (commands.Pop(command))
+	{
+		// Publish even when the command changed nothing, so the render side sees it was consumed
+		++consumedCommands;
+		consumedTime = LatencyTracker::Now();
+		isFrameDirty = true;
+
+		switch (command)
+		{
+		case Command::NewGame:
+			player.Close();
+			isWatching = false;
+			StartNewGame();
+			break;
+		case Command::WatchReplay:
+			StartWatching();
+			break;
+		case Command::SeekReplay:
+			if (isWatching)
+			{
+				SeekReplay(seekTarget);
+			}
+			break;
+		case Command::Pause:
+			isRunning = false;
+			isFrameDirty = true;
+			break;
+		case Command::Resume:
+			if (currentTetromino && !isGameOver)
+			{
+				isRunning = true;
+				tickAccumulator = 0.0;
+				isFrameDirty = true;
+			}
+			break;
+		case Command::Place:
+			if (isRunning && !isWatching)
+			{
+				PlanPlacement(placeTarget);
+			}
+			break;
+		default:
+			if (isRunning && !isWatching && batchedActionCount < maxBatchedActions)
+			{
+				batchedActions[batchedActionCount++] = command;
+			}
+			break;
+		}
+	}
+
+	FlushBatchedActions();
+}
+
+void Simulation::FlushBatchedActions()
+{
+	if (batchedActionCount == 0)
+		return;
+
+	const bool isJournaled = journal.IsOpen() &&
+		journal.Append(Journal::RecordType::Input, elapsedTicks, batchedActions.data(), batchedActionCount * sizeof(Command));
+	recorder.AddInput(elapsedTicks, reinterpret_cast<const uint8_t*>(batchedActions.data()), batchedActionCount);
+	for (int i = 0; i < batchedActionCount; ++i)
+	{
+		ApplyAction(batchedActions[i]);
+	}
+	batchedActionCount = 0;
+
+	if (journal.IsOpen() && !isJournaled)
+	{
+		// No room left for the record, checkpoint the state it produced instead
+		WriteCheckpoint();
+	}
+}
+
+void Simulation::ApplyAction(Command command)
+{
+	switch (command)
+	{
+	case Command::MoveLeft:
+		currentTetromino->MoveLeft();
+		break;
+	case Command::MoveRight:
+		currentTetromino->MoveRight();
+		break;
+	case Command::RotateClockwise:
+		currentTetromino->RotateClockwise();
+		break;
+	case Command::RotateCounterClockwise:
+		currentTetromino->RotateCounterClockwise();
+		break;
+	case Command::Drop:
+		currentTetromino->Drop();
+		break;
+	case Command::ResetBoard:
+		board.Reset();
+		currentTetromino->Reset();
+		break;
+	default:
+		break;
+	}
+}
+
+void Simulation::StepGameplay()
+{
+	++elapsedTicks;
+
+	// Increase speed level every 60 seconds
+	if (elapsedTicks >= settings::ticksPerLevel * speedLevel) {
+		speedLevel++;
+		isFrameDirty = true;
+	}
+
+	currentTetromino->Tick(gravity::ForLevel(speedLevel));
+
+	if (currentTetromino->HasLanded()) {
+		const Tetromino::State state = currentTetromino->GetState();
+		lastLock = { static_cast<int32_t>(currentTetromino->GetType()), state.pos.GetX(), state.pos.GetY(), static_cast<int32_t>(state.rotation) };
+
+		currentTetromino->AddToBoard();
+		int cleared = 0;
+		if (isReplaying) {
+			cleared = board.Update();
+		}
+		else {
+			currentTetromino->EmitLockParticles(particles);
+			cleared = board.Update(particles);
+		}
+		lines += cleared;
+		score += settings::lineClearScores[std::min(cleared, 4)] * speedLevel;
+		currentTetromino.emplace(randomizer.Next(), board);
+		isFrameDirty = true;
+
+		if (IsRecording() && journal.IsOpen()) {
+			// Compact into a fresh checkpoint every few locks, or early if the journal fills up
+			if (++locksSinceCheckpoint >= settings::locksPerCheckpoint || !journal.Append(Journal::RecordType::Lock, elapsedTicks, &lastLock, sizeof(lastLock))) {
+				WriteCheckpoint();
+			}
+		}
+
+		if (IsRecording() && board.IsTopRowOccupied()) {
+			board.EmitBoardParticles(particles, settings::topOutParticlesPerCell);
+			isRunning = false;
+			isGameOver = true;
+			// A finished game must not be restored on the next start
+			journal.Clear();
+			// The final board ends the replay
+			GameSnapshot snapshot;
+			CaptureSnapshot(snapshot);
+			recorder.AddKeyframe(snapshot);
+			recorder.Close();
+			return;
+		}
+	}
+
+	if (IsRecording() && recorder.IsKeyframeDue(elapsedTicks)) {
+		GameSnapshot snapshot;
+		CaptureSnapshot(snapshot);
+		recorder.AddKeyframe(snapshot);
+	}
+
+#ifdef PLATFORM_WEB
+	// Browser storage only persists when synced, do it regularly rather than only at checkpoints
+	if (IsRecording() && elapsedTicks % settings::journalFlushTicks == 0) {
+		journal.Flush();
+	}
+#endif
+}
+
+bool Simulation::IsRecording() const
+{
+	return !isReplaying && !isWatching;
+}
+
+void Simulation::StartWatching()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	recorder.Close();
+	isWatching = player.Open(watchPath);
+	isRunning = false;
+	isGameOver = false;
+	isFrameDirty = true;
+	if (!isWatching)
+		return;
+
+	++gameId;
+	SeekReplay(0);
+	isRunning = true;
+}
+
+void Simulation::StepReplay()
+{
+	// Inputs recorded at a tick were applied after that tick was simulated
+	while (hasPendingInput && pendingInput.tick <= elapsedTicks)
+	{
+		for (int i = 0; i < pendingInput.count; ++i)
+		{
+			ApplyAction(static_cast<Command>(pendingInput.commands[i]));
+		}
+		hasPendingInput = player.NextInput(pendingInput);
+	}
+
+	if (elapsedTicks >= player.GetLastTick())
+	{
+		isRunning = false;
+		isFrameDirty = true;
+		return;
+	}
+	StepGameplay();
+
+#ifndef NDEBUG
+	// Playback has to pass through every keyframe in exactly the recorded state
+	GameSnapshot keyframe;
+	if (player.ReadKeyframe(elapsedTicks, keyframe)) {
+		assert(zobrist::HashSnapshot(keyframe) == GetStateHash());
+	}
+#endif
+}
+
+void Simulation::SeekReplay(int32_t tick)
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	tick = std::clamp(tick, 0, player.GetLastTick());
+	GameSnapshot snapshot;
+	if (!player.SeekKeyframe(tick, snapshot))
+		return;
+	RestoreSnapshot(snapshot);
+	hasPendingInput = player.NextInput(pendingInput);
+
+	// Only the ticks since the keyframe are simulated again
+	isReplaying = true;
+	while (elapsedTicks < tick)
+	{
+		StepReplay();
+	}
+	isReplaying = false;
+}
+
+void Simulation::PlanPlacement(int32_t target)
+{
+	// Moves posted before the tap have to be applied first, the path starts from where they leave the piece
+	FlushBatchedActions();
+
+	std::array<uint32_t, PathPlanner::maxHeight> rows;
+	for (int y = 0; y < board.GetHeight(); ++y)
+	{
+		rows[y] = board.GetRowMask(y);
+	}
+	const Tetromino::State state = currentTetromino->GetState();
+	const PathPlanner::Placement start = { state.pos.GetX(), state.pos.GetY(), static_cast<int>(state.rotation) / 90 };
+	const int targetX = static_cast<int16_t>(target & 0xFFFF);
+	const int targetY = target >> 16;
+	if (!planner.Plan(rows.data(), board.GetWidth(), board.GetHeight(), currentTetromino->GetType(), start, targetX, targetY))
+		return;
+
+	// The path goes through the batch as ordinary moves, so the journal and the replay
+	// don't need to know about planning
+	static_assert(PathPlanner::maxPathLength <= maxBatchedActions);
+	for (int i = 0; i < planner.GetMoveCount(); ++i)
+	{
+		switch (planner.GetMove(i))
+		{
+		case PathPlanner::Move::Left:
+			batchedActions[batchedActionCount++] = Command::MoveLeft;
+			break;
+		case PathPlanner::Move::Right:
+			batchedActions[batchedActionCount++] = Command::MoveRight;
+			break;
+		case PathPlanner::Move::RotateClockwise:
+			batchedActions[batchedActionCount++] = Command::RotateClockwise;
+			break;
+		case PathPlanner::Move::RotateCounterClockwise:
+			batchedActions[batchedActionCount++] = Command::RotateCounterClockwise;
+			break;
+		case PathPlanner::Move::Down:
+			batchedActions[batchedActionCount++] = Command::Drop;
+			break;
+		}
+	}
+}
+
+void Simulation::StartNewGame()
+{
+	AllocationScope allocationScope(AllocationTag::Session);
+	board.Reset();
+	elapsedTicks = 0;
+	tickAccumulator = 0.0;
+	speedLevel = settings::initialLevel;
+	score = 0;
+	lines = 0;
+	seed = GenerateSeed();
+	randomizer.Seed(seed);
+	currentTetromino.emplace(randomizer.Next(), board);
+	batchedActionCount = 0;
+	isRunning = true;
+	isGameOver = false;
+	++gameId;
+	isFrameDirty = true;
+
+	if (journal.IsOpen())
+	{
+		WriteCheckpoint();
+	}
+	if (recorder.Open(recordPath, settings::replayKeyframeTicks))
+	{
+		GameSnapshot snapshot;
+		CaptureSnapshot(snapshot);
+		recorder.AddKeyframe(snapshot);
+	}
+}
+
+bool Simulation::HasChanged() const
+{
+	if (isFrameDirty || board.GetRevision() != publishedBoardRevision)
+		return true;
+	return currentTetromino && (currentTetromino->GetRevision() != publishedPieceRevision ||
+		elapsedTicks / settings::ticksPerSecond != publishedSeconds);
+}
+
+void Simulation::PublishFrame()
+{
+	Frame& frame = frames.GetWriteBuffer();
+	frame.hasGame = currentTetromino.has_value();
+	if (frame.hasGame)
+	{
+		CaptureSnapshot(frame.snapshot);
+	}
+	frame.sequence = ++frameSequence;
+	frame.gameId = gameId;
+	frame.commandsConsumed = consumedCommands;
+	frame.consumedTime = consumedTime;
+	frame.replayLastTick = isWatching ? player.GetLastTick() : 0;
+	frame.isRunning = isRunning;
+	frame.isGameOver = isGameOver;
+	frame.isWatching = isWatching;
+	frames.Publish();
+
+	isFrameDirty = false;
+	publishedBoardRevision = board.GetRevision();
+	publishedPieceRevision = currentTetromino ? currentTetromino->GetRevision() : 0;
+	publishedSeconds = elapsedTicks / settings::ticksPerSecond;
+}
+
+void Simulation::CaptureSnapshot(GameSnapshot& snapshot) const
+{
+	std::memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.seed = seed;
+	snapshot.randomizerState = randomizer.GetState();
+	snapshot.elapsedTicks = elapsedTicks;
+	snapshot.speedLevel = speedLevel;
+	snapshot.score = score;
+	snapshot.lines = lines;
+
+	const Tetromino::State state = currentTetromino->GetState();
+	snapshot.pieceType = static_cast<int32_t>(currentTetromino->GetType());
+	snapshot.pieceX = state.pos.GetX();
+	snapshot.pieceY = state.pos.GetY();
+	snapshot.pieceRotation = static_cast<int32_t>(state.rotation);
+	snapshot.gravityAccumulator = state.gravityAccumulator;
+
+	CaptureBoard(board, snapshot);
+}
+
+void Simulation::RestoreSnapshot(const GameSnapshot& snapshot)
+{
+	RestoreBoard(snapshot, board);
+
+	seed = snapshot.seed;
+	randomizer.SetState(snapshot.randomizerState);
+	elapsedTicks = snapshot.elapsedTicks;
+	speedLevel = snapshot.speedLevel;
+	score = snapshot.score;
+	lines = snapshot.lines;
+	tickAccumulator = 0.0;
+	batchedActionCount = 0;
+
+	currentTetromino.emplace(static_cast<PieceType>(snapshot.pieceType), board);
+	currentTetromino->SetState({ { snapshot.pieceX, snapshot.pieceY },
+		static_cast<Tetromino::Rotation>(snapshot.pieceRotation), snapshot.gravityAccumulator });
+	isFrameDirty = true;
+}
+
+void Simulation::WriteCheckpoint()
+{
+	GameSnapshot snapshot;
+	CaptureSnapshot(snapshot);
+	journal.WriteCheckpoint(&snapshot, sizeof(snapshot));
+	journal.Flush();
+	locksSinceCheckpoint = 0;
+}
+
+bool Simulation::RestoreFromJournal()
+{
+	int size = 0;
+	const uint8_t* data = journal.GetCheckpoint(size);
+	if (!data || size != sizeof(GameSnapshot))
+		return false;
+
+	GameSnapshot snapshot;
+	std::memcpy(&snapshot, data, sizeof(snapshot));
+	if (snapshot.pieceType < 0 || snapshot.pieceType >= static_cast<int32_t>(PieceType::Count))
+		return false;
+	RestoreSnapshot(snapshot);
+	++gameId;
+
+	// Re-simulate everything recorded after the checkpoint
+	isReplaying = true;
+	Journal::Record record;
+	int offset = 0;
+	while (journal.ReadRecord(offset, record))
+	{
+		while (elapsedTicks < record.tick)
+		{
+			StepGameplay();
+		}
+
+		if (record.type == Journal::RecordType::Input)
+		{
+			for (int i = 0; i < record.size; ++i)
+			{
+				ApplyAction(static_cast<Command>(record.payload[i]));
+			}
+		}
+		else if (record.type == Journal::RecordType::Lock)
+		{
+			// The replayed lock has to match the recorded one, stop at the first divergence
+			if (record.size != sizeof(LockRecord) || std::memcmp(&lastLock, record.payload, sizeof(LockRecord)) != 0)
+				break;
+		}
+	}
+	isReplaying = false;
+
+	// Fold the replayed tail into a fresh checkpoint
+	WriteCheckpoint();
+	return true;
+}
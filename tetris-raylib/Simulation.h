@@ -0,0 +1,168 @@
+#pragma once
+#include <optional>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#ifndef PLATFORM_WEB
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+#include "Board.h"
+#include "Tetromino.h"
+#include "ParticleSystem.h"
+#include "GameUtils.h"
+#include "GameSnapshot.h"
+#include "Journal.h"
+#include "Replay.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "PathPlanner.h"
+
+// The game rules and everything that has to survive a crash. On desktop this runs on
+// its own thread at the fixed tick rate, so a stalled frame present never delays input
+// or gravity. The render thread only posts commands and reads the latest published
+// frame, which is an immutable copy of the state.
+class Simulation
+{
+public:
+	// The gameplay commands are journaled as raw bytes, keep their values stable
+	enum class Command : uint8_t
+	{
+		MoveLeft,
+		MoveRight,
+		RotateClockwise,
+		RotateCounterClockwise,
+		Drop,
+		ResetBoard,
+		NewGame,
+		Pause,
+		Resume,
+		WatchReplay,
+		SeekReplay,
+		Place	// Expanded into the moves that reach the target, only those are recorded
+	};
+	struct Frame
+	{
+		GameSnapshot snapshot;	// Only valid with hasGame
+		uint32_t sequence;	// Zero until the first frame is published
+		uint32_t gameId;	// Bumped on every new game or replay
+		uint32_t commandsConsumed;	// Every posted command up to this one is reflected
+		int64_t consumedTime;	// LatencyTracker clock when the last of them was consumed
+		int32_t replayLastTick;
+		bool hasGame;
+		bool isRunning;
+		bool isGameOver;
+		bool isWatching;
+	};
+public:
+	// Every game is recorded to recordPath, WatchReplay plays back watchPath
+	Simulation(ParticleSystem& particles, std::string recordPath, std::string watchPath);
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+	~Simulation() noexcept;
+
+	// Opens the autosave, returns true if an interrupted game was restored (paused)
+	bool Open(const std::string& journalPath);
+	void Start();
+	void Stop();
+
+	// Render thread side
+	bool Post(Command command);
+	bool PostSeek(int32_t tick);
+	// Moves the falling piece to the resting placement nearest the given board cell
+	bool PostPlace(int x, int y);
+	// Commands posted so far, compare with Frame::commandsConsumed
+	uint32_t GetPostedCount() const;
+	bool FetchFrame();
+	const Frame& GetFrame() const;
+
+	// Simulation thread side, driven by the thread on desktop and by the frame loop on web
+	void Update(double deltaTime);
+	// Zobrist hash of the board, the falling piece and the upcoming sequence, zero without a game
+	uint64_t GetStateHash() const;
+private:
+	void ProcessCommands();
+	void FlushBatchedActions();
+	void ApplyAction(Command command);
+	void StepGameplay();
+	void StartNewGame();
+	bool IsRecording() const;
+	void StartWatching();
+	void StepReplay();
+	void SeekReplay(int32_t tick);
+	void PlanPlacement(int32_t target);
+	bool HasChanged() const;
+	void PublishFrame();
+	void CaptureSnapshot(GameSnapshot& snapshot) const;
+	void RestoreSnapshot(const GameSnapshot& snapshot);
+	void WriteCheckpoint();
+	bool RestoreFromJournal();
+#ifndef PLATFORM_WEB
+	void Run();
+#endif
+private:
+	ParticleSystem& particles;
+	Board board;
+	std::optional<Tetromino> currentTetromino;
+	int elapsedTicks = 0;
+	double tickAccumulator = 0.0;
+	int speedLevel;
+	uint64_t seed = 0;
+	PieceRandomizer randomizer;
+	int score = 0;
+	int lines = 0;
+	bool isRunning = false;
+	bool isGameOver = false;
+	uint32_t gameId = 0;
+
+	static constexpr int maxBatchedActions = 64;
+	std::array<Command, maxBatchedActions> batchedActions;
+	int batchedActionCount = 0;
+
+	// Autosave, every input batch and lock is appended and replayed after a crash
+	struct LockRecord
+	{
+		int32_t pieceType;
+		int32_t x;
+		int32_t y;
+		int32_t rotation;
+	};
+	Journal journal;
+	LockRecord lastLock = {};
+	int locksSinceCheckpoint = 0;
+	bool isReplaying = false;	// Re-simulating ticks, nothing is recorded and no effects are shown
+
+	// Replays, the recording of the current game or the playback of an old one
+	const std::string recordPath;
+	const std::string watchPath;
+	ReplayWriter recorder;
+	ReplayReader player;
+	ReplayReader::Input pendingInput = {};
+	bool hasPendingInput = false;
+	bool isWatching = false;
+	std::atomic<int32_t> seekTarget = 0;
+
+	// Tap to place
+	PathPlanner planner;
+	std::atomic<int32_t> placeTarget = 0;	// Board cell, x in the low 16 bits
+
+	// Hand-off to the render thread
+	SpscQueue<Command, 64> commands;
+	uint32_t postedCommands = 0;	// Render thread
+	uint32_t consumedCommands = 0;
+	int64_t consumedTime = 0;
+	TripleBuffer<Frame> frames;
+	uint32_t frameSequence = 0;
+	bool isFrameDirty = false;
+	unsigned int publishedBoardRevision = 0;
+	unsigned int publishedPieceRevision = 0;
+	int publishedSeconds = 0;
+
+#ifndef PLATFORM_WEB
+	std::thread thread;
+	std::atomic<bool> isStopping = false;
+	std::mutex wakeMutex;
+	std::condition_variable wakeSignal;
+#endif
+};
\ No newline at end of file
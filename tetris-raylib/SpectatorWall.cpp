@@ -0,0 +1,268 @@
+#include "SpectatorWall.h"
+#include <assert.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Settings.h"
+#include "GameUtils.h"
+#include "Tetromino.h"
+#include "Heuristics.h"
+
+namespace
+{
+	constexpr Color gutterColor = { 0, 0, 0, 255 };
+	constexpr Color emptyColor = { 24, 24, 24, 255 };
+	constexpr Color settledColor = { 130, 130, 130, 255 };
+	constexpr int drawnPieceFields = 4;
+
+	EnvAction ToEnvAction(PathPlanner::Move move)
+	{
+		switch (move)
+		{
+		case PathPlanner::Move::Left: return EnvAction::MoveLeft;
+		case PathPlanner::Move::Right: return EnvAction::MoveRight;
+		case PathPlanner::Move::RotateClockwise: return EnvAction::RotateClockwise;
+		case PathPlanner::Move::RotateCounterClockwise: return EnvAction::RotateCounterClockwise;
+		case PathPlanner::Move::Down: return EnvAction::Drop;
+		}
+		return EnvAction::None;
+	}
+}
+
+SpectatorWall::SpectatorWall(int count, int screenWidth, int screenHeight)
+	:
+	count(count),
+	rows(count * height),
+	pieceTypes(count),
+	pieceXs(count),
+	pieceYs(count),
+	pieceRotations(count),
+	rewards(count),
+	dones(count),
+	env(count, { rows.data(), pieceTypes.data(), pieceXs.data(), pieceYs.data(), pieceRotations.data(), rewards.data(), dones.data() }),
+	actions(count),
+	bots(count),
+	drawnRows(count * height),
+	drawnPieces(count * drawnPieceFields)
+{
+	std::vector<uint64_t> seeds(count);
+	for (uint64_t& seed : seeds)
+	{
+		seed = GenerateSeed();
+	}
+	env.Reset(seeds.data());
+	// Optional, without a book the bots score every placement
+	book.Open(settings::openingBookPath, width, height);
+
+	// Pick the grid shape that makes the boards largest, snapping to whole pixels per cell when they fit
+	const float areaWidth = static_cast<float>(screenWidth);
+	const float areaHeight = static_cast<float>(screenHeight - hudHeight);
+	float scale = 0.0f;
+	for (int c = 1; c <= count; ++c)
+	{
+		const int r = (count + c - 1) / c;
+		const float s = std::min(areaWidth / (c * tileWidth), areaHeight / (r * tileHeight));
+		if (s > scale)
+		{
+			scale = s;
+			columns = c;
+		}
+	}
+	if (scale >= 1.0f)
+	{
+		scale = static_cast<float>(static_cast<int>(scale));
+	}
+	atlasWidth = columns * tileWidth;
+	atlasHeight = ((count + columns - 1) / columns) * tileHeight;
+	destination = { (areaWidth - atlasWidth * scale) / 2, hudHeight + (areaHeight - atlasHeight * scale) / 2,
+		atlasWidth * scale, atlasHeight * scale };
+
+	pixels.assign(atlasWidth * atlasHeight, gutterColor);
+	for (int i = 0; i < count; ++i)
+	{
+		RasterizeBoard(i);
+	}
+	const Image image = { pixels.data(), atlasWidth, atlasHeight, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+	texture = LoadTextureFromImage(image);
+	SetTextureFilter(texture, TEXTURE_FILTER_POINT);
+	dirtyFirstRow = noDirtyRow;
+	dirtyLastRow = -1;
+}
+
+SpectatorWall::~SpectatorWall() noexcept
+{
+	UnloadTexture(texture);
+}
+
+bool SpectatorWall::Update(float frameTime)
+{
+	tickAccumulator += frameTime;
+	int ticks = 0;
+	while (tickAccumulator >= settings::tickDuration && ticks < settings::spectatorMaxTicksPerFrame)
+	{
+		tickAccumulator -= settings::tickDuration;
+		Tick();
+		++ticks;
+	}
+	// Fall behind rather than spiral when a frame takes too long
+	tickAccumulator = std::min(tickAccumulator, settings::tickDuration);
+	if (ticks == 0)
+		return false;
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (HasBoardChanged(i))
+		{
+			RasterizeBoard(i);
+		}
+	}
+	if (dirtyFirstRow > dirtyLastRow)
+		return false;
+
+	// Tile rows are contiguous in the atlas, so the changed band is one upload
+	const int firstLine = dirtyFirstRow * tileHeight;
+	const int lineCount = (dirtyLastRow - dirtyFirstRow + 1) * tileHeight;
+	UpdateTextureRec(texture, { 0.0f, static_cast<float>(firstLine), static_cast<float>(atlasWidth), static_cast<float>(lineCount) },
+		pixels.data() + firstLine * atlasWidth);
+	dirtyFirstRow = noDirtyRow;
+	dirtyLastRow = -1;
+	return true;
+}
+
+void SpectatorWall::Draw() const
+{
+	DrawTexturePro(texture, { 0.0f, 0.0f, static_cast<float>(atlasWidth), static_cast<float>(atlasHeight) },
+		destination, { 0.0f, 0.0f }, 0.0f, WHITE);
+}
+
+int SpectatorWall::GetCount() const
+{
+	return count;
+}
+
+uint64_t SpectatorWall::GetTopOuts() const
+{
+	return topOuts;
+}
+
+void SpectatorWall::Tick()
+{
+	for (int i = 0; i < count; ++i)
+	{
+		Bot& bot = bots[i];
+		if (bot.spawnCount != env.GetSpawnCount(i))
+		{
+			bot.spawnCount = env.GetSpawnCount(i);
+			ChoosePlacement(i);
+		}
+		actions[i] = static_cast<uint8_t>(bot.nextMove < bot.moveCount ? bot.moves[bot.nextMove++] : EnvAction::None);
+	}
+
+	env.Step(actions.data());
+	for (int i = 0; i < count; ++i)
+	{
+		topOuts += dones[i];
+	}
+}
+
+void SpectatorWall::ChoosePlacement(int i)
+{
+	Bot& bot = bots[i];
+	bot.moveCount = 0;
+	bot.nextMove = 0;
+
+	const PieceType type = static_cast<PieceType>(pieceTypes[i]);
+	const PathPlanner::Placement start = { pieceXs[i], pieceYs[i], pieceRotations[i] };
+	if (!planner.Search(rows.data() + i * height, width, height, type, start))
+		return;
+
+	// The first pieces of a game usually have a book move
+	int best = FindBookPlacement(i);
+	if (best < 0)
+	{
+		int bestScore = 0;
+		for (int p = 0; p < planner.GetPlacementCount(); ++p)
+		{
+			const int score = ScorePlacement(i, planner.GetPlacement(p));
+			if (best < 0 || score > bestScore)
+			{
+				best = p;
+				bestScore = score;
+			}
+		}
+	}
+	if (best < 0 || !planner.BuildPath(best))
+		return;
+
+	bot.moveCount = planner.GetMoveCount();
+	for (int m = 0; m < bot.moveCount; ++m)
+	{
+		bot.moves[m] = ToEnvAction(planner.GetMove(m));
+	}
+}
+
+int SpectatorWall::FindBookPlacement(int i) const
+{
+	if (!book.IsOpen())
+		return -1;
+	PieceRandomizer preview;
+	preview.SetState(env.GetRandomizerState(i));
+	const uint64_t key = OpeningBook::MakeKey(rows.data() + i * height, height, static_cast<PieceType>(pieceTypes[i]), preview.Next());
+	PathPlanner::Placement placement;
+	return book.Find(key, placement) ? planner.FindPlacement(placement) : -1;
+}
+
+int SpectatorWall::ScorePlacement(int i, const PathPlanner::Placement& placement) const
+{
+	// Only has to look like someone is playing
+	std::array<uint32_t, height> board;
+	std::copy_n(rows.begin() + i * height, height, board.begin());
+	const int cleared = heuristics::ApplyPlacement(board.data(), width, height, static_cast<PieceType>(pieceTypes[i]), placement);
+	return heuristics::ScoreBoard(board.data(), width, height, cleared);
+}
+
+bool SpectatorWall::HasBoardChanged(int i) const
+{
+	const int32_t* drawn = drawnPieces.data() + i * drawnPieceFields;
+	return drawn[0] != pieceTypes[i] || drawn[1] != pieceXs[i] || drawn[2] != pieceYs[i] || drawn[3] != pieceRotations[i] ||
+		std::memcmp(drawnRows.data() + i * height, rows.data() + i * height, height * sizeof(uint32_t)) != 0;
+}
+
+void SpectatorWall::RasterizeBoard(int i)
+{
+	const uint32_t* boardRows = rows.data() + i * height;
+	std::copy_n(boardRows, height, drawnRows.begin() + i * height);
+	int32_t* drawn = drawnPieces.data() + i * drawnPieceFields;
+	drawn[0] = pieceTypes[i];
+	drawn[1] = pieceXs[i];
+	drawn[2] = pieceYs[i];
+	drawn[3] = pieceRotations[i];
+
+	const int tileRow = i / columns;
+	Color* tile = pixels.data() + tileRow * tileHeight * atlasWidth + (i % columns) * tileWidth;
+	for (int y = 0; y < height; ++y)
+	{
+		Color* line = tile + y * atlasWidth;
+		for (int x = 0; x < width; ++x)
+		{
+			line[x] = ((boardRows[y] >> x) & 1u) ? settledColor : emptyColor;
+		}
+	}
+
+	const PieceType type = static_cast<PieceType>(pieceTypes[i]);
+	const pieces::Footprint& f = pieces::GetFootprint(type, pieceRotations[i]);
+	const Color pieceColor = Tetromino::GetColor(type);
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		for (int c = f.minX; c <= f.maxX; ++c)
+		{
+			if ((f.rows[r] >> c) & 1u)
+			{
+				tile[(pieceYs[i] + r) * atlasWidth + pieceXs[i] + c] = pieceColor;
+			}
+		}
+	}
+
+	dirtyFirstRow = std::min(dirtyFirstRow, tileRow);
+	dirtyLastRow = std::max(dirtyLastRow, tileRow);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "raylibCpp.h"
+#include "VecEnv.h"
+#include "PathPlanner.h"
+#include "OpeningBook.h"
+
+// A grid of bot-driven games for watching a soak farm. The games run in lockstep on
+// VecEnv, and every board is one tile of a single texture with a pixel per cell, so
+// the whole wall is drawn with one textured quad. Only boards that changed since the
+// last frame are rasterized again, and only the band of tile rows holding them is
+// uploaded.
+class SpectatorWall
+{
+public:
+	// Creates the wall texture, so the window has to be open
+	SpectatorWall(int count, int screenWidth, int screenHeight);
+	SpectatorWall(const SpectatorWall&) = delete;
+	SpectatorWall& operator=(const SpectatorWall&) = delete;
+	~SpectatorWall() noexcept;
+
+	// Runs the games at the tick rate, returns true if any board changed
+	bool Update(float frameTime);
+	void Draw() const;
+	int GetCount() const;
+	uint64_t GetTopOuts() const;
+private:
+	static constexpr int width = VecEnv::width;
+	static constexpr int height = VecEnv::height;
+	static constexpr int tileWidth = width + 1;	// One pixel gutter between boards
+	static constexpr int tileHeight = height + 1;
+	static constexpr int hudHeight = 30;
+
+	void Tick();
+	void ChoosePlacement(int i);
+	int FindBookPlacement(int i) const;
+	int ScorePlacement(int i, const PathPlanner::Placement& placement) const;
+	bool HasBoardChanged(int i) const;
+	void RasterizeBoard(int i);
+private:
+	const int count;
+
+	// Observation buffers the games live in
+	std::vector<uint32_t> rows;
+	std::vector<int32_t> pieceTypes;
+	std::vector<int32_t> pieceXs;
+	std::vector<int32_t> pieceYs;
+	std::vector<int32_t> pieceRotations;
+	std::vector<float> rewards;
+	std::vector<uint8_t> dones;
+	VecEnv env;
+	std::vector<uint8_t> actions;
+	double tickAccumulator = 0.0;
+	uint64_t topOuts = 0;
+
+	// Each bot picks a placement when its piece spawns and plays one move per tick
+	struct Bot
+	{
+		std::array<EnvAction, PathPlanner::maxPathLength> moves;
+		int moveCount = 0;
+		int nextMove = 0;
+		uint32_t spawnCount = 0;
+	};
+	PathPlanner planner;
+	OpeningBook book;
+	std::vector<Bot> bots;
+
+	// What each tile showed when it was last rasterized
+	std::vector<uint32_t> drawnRows;
+	std::vector<int32_t> drawnPieces;	// Type, x, y and rotation per board
+
+	int columns = 1;
+	int atlasWidth = 0;
+	int atlasHeight = 0;
+	Rectangle destination = {};
+	std::vector<Color> pixels;
+	Texture2D texture = {};
+	// Tile rows to upload, none while first > last
+	static constexpr int noDirtyRow = std::numeric_limits<int>::max();
+	int dirtyFirstRow = noDirtyRow;
+	int dirtyLastRow = -1;
+};
\ No newline at end of file
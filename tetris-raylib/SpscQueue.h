@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity has to be a power of two, pushing into a full queue fails instead of blocking.
+template <typename T, int capacity>
+class SpscQueue
+{
+	static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+	SpscQueue() = default;
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer side
+	bool Push(const T& value)
+	{
+		const unsigned int tail = this->tail.load(std::memory_order_relaxed);
+		if (tail - head.load(std::memory_order_acquire) == capacity)
+			return false;
+		items[tail & (capacity - 1)] = value;
+		this->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	bool Pop(T& value)
+	{
+		const unsigned int head = this->head.load(std::memory_order_relaxed);
+		if (head == tail.load(std::memory_order_acquire))
+			return false;
+		value = items[head & (capacity - 1)];
+		this->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+	bool IsEmpty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+private:
+	std::array<T, capacity> items = {};
+	// Free-running counters, the difference is the fill level even after wrapping
+	std::atomic<unsigned int> head = 0;
+	std::atomic<unsigned int> tail = 0;
+};
\ No newline at end of file
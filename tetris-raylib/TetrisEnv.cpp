@@ -0,0 +1,40 @@
+#include "TetrisEnv.h"
+#include "VecEnv.h"
+
+static_assert(TETRIS_ENV_DROP == static_cast<int>(EnvAction::Drop) &&
+	TETRIS_ENV_ACTION_COUNT == static_cast<int>(EnvAction::Count), "The C actions are the EnvAction values");
+
+struct TetrisEnv
+{
+	VecEnv env;
+};
+
+TetrisEnv* TetrisEnvCreate(int count, const VecEnvBuffers* buffers)
+{
+	return new TetrisEnv{ VecEnv(count, *buffers) };
+}
+
+void TetrisEnvDestroy(TetrisEnv* env)
+{
+	delete env;
+}
+
+void TetrisEnvReset(TetrisEnv* env, const uint64_t* seeds)
+{
+	env->env.Reset(seeds);
+}
+
+void TetrisEnvStep(TetrisEnv* env, const uint8_t* actions)
+{
+	env->env.Step(actions);
+}
+
+int TetrisEnvBoardWidth(void)
+{
+	return VecEnv::width;
+}
+
+int TetrisEnvBoardHeight(void)
+{
+	return VecEnv::height;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+
+// C interface of VecEnv for training code, plain C so ctypes, cffi or any FFI can load it.
+// It is built on its own as the tetris-env shared library, VecEnv and the pieces without
+// raylib. tetris-env.vcxproj builds the DLL, elsewhere:
+//   g++ -std=c++17 -O2 -shared -fPIC -DTETRIS_ENV_BUILD TetrisEnv.cpp VecEnv.cpp Pieces.cpp -o libtetris-env.so
+// Semantics are VecEnv's: a step applies one action per game and then one gravity tick,
+// a game that tops out reports done and is reset in the same step.
+
+#ifdef _WIN32
+#ifdef TETRIS_ENV_BUILD
+#define TETRIS_ENV_API __declspec(dllexport)
+#else
+#define TETRIS_ENV_API __declspec(dllimport)
+#endif
+#else
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Actions, one byte per game, the values of EnvAction
+enum
+{
+	TETRIS_ENV_NONE,
+	TETRIS_ENV_MOVE_LEFT,
+	TETRIS_ENV_MOVE_RIGHT,
+	TETRIS_ENV_ROTATE_CLOCKWISE,
+	TETRIS_ENV_ROTATE_COUNTER_CLOCKWISE,
+	TETRIS_ENV_DROP,
+	TETRIS_ENV_ACTION_COUNT
+};
+
+// Caller-owned observation buffers, the games are stepped in place in them
+typedef struct VecEnvBuffers
+{
+	uint32_t* rows;	// count * height row masks, bit x set for a settled cell, row 0 on top
+	int32_t* pieceType;	// count each
+	int32_t* pieceX;
+	int32_t* pieceY;
+	int32_t* pieceRotation;	// Clockwise quarter turns, 0 to 3
+	float* rewards;	// Score gained in the step
+	uint8_t* dones;
+} VecEnvBuffers;
+
+typedef struct TetrisEnv TetrisEnv;
+
+TETRIS_ENV_API TetrisEnv* TetrisEnvCreate(int count, const VecEnvBuffers* buffers);
+TETRIS_ENV_API void TetrisEnvDestroy(TetrisEnv* env);
+// count seeds, each the randomizer state of a new game
+TETRIS_ENV_API void TetrisEnvReset(TetrisEnv* env, const uint64_t* seeds);
+// count actions
+TETRIS_ENV_API void TetrisEnvStep(TetrisEnv* env, const uint8_t* actions);
+TETRIS_ENV_API int TetrisEnvBoardWidth(void);
+TETRIS_ENV_API int TetrisEnvBoardHeight(void);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -1,21 +1,31 @@
 #include "Tetromino.h"
 #include "Board.h"
+#include "Settings.h"
+#include "Gravity.h"
+#include "Zobrist.h"
 
-Tetromino::Tetromino(const bool* shape, int dimension, Color color, Board& board)
+namespace
+{
+	constexpr Color pieceColors[] = { BLUE, YELLOW, PURPLE, ORANGE, GREEN, RED, MAROON };
+	static_assert(sizeof(pieceColors) / sizeof(pieceColors[0]) == static_cast<int>(PieceType::Count));
+}
+
+template<typename BoardType>
+BasicTetromino<BoardType>::BasicTetromino(PieceType type, BoardType& board)
 	:
-	shape(shape),
-	dimension(dimension),
-	color(color),
-	pos(board.GetWidth() / 2 - dimension / 2, 0),
+	type(type),
+	dimension(pieces::GetShape(type).dimension),
+	color(pieceColors[static_cast<int>(type)]),
+	pos(pieces::SpawnX(type, board.GetWidth()), 0),
 	board(board),
 	currentRotation(Rotation::Zero),
 	hasLanded(false),
-	timeSinceLastMove(0.0f),
-	moveInterval(1.0f)
+	gravityAccumulator(0)
 {
 }
 
-void Tetromino::Draw() const
+template<typename BoardType>
+void BasicTetromino<BoardType>::Draw() const
 {
 	for (int y = 0; y < dimension; ++y)
 	{
@@ -28,7 +38,8 @@ void Tetromino::Draw() const
 	}
 }
 
-Vec2<int> Tetromino::GetLastPos() const {
+template<typename BoardType>
+Vec2<int> BasicTetromino<BoardType>::GetLastPos() const {
 	int highestX = 0;
 	int highestY = 0;
 
@@ -44,74 +55,63 @@ Vec2<int> Tetromino::GetLastPos() const {
 	return pos + Vec2<int>(highestX, highestY);
 }
 
-bool Tetromino::IsCellAt(int x, int y) const
+template<typename BoardType>
+bool BasicTetromino<BoardType>::IsCellAt(int x, int y) const
 {
-	switch (currentRotation) {
-	case Rotation::Zero:
-		return shape[y * dimension + x];
-	case Rotation::Ninety:
-		return shape[dimension * (dimension - 1) - dimension * x + y];
-	case Rotation::OneEighty:
-		return shape[dimension * (dimension - y) - (x + 1)];
-	case Rotation::TwoSeventy:
-		return shape[(dimension - 1) + dimension * x - y];
-	default:
-		return false;
-	}
-
+	const pieces::Footprint& footprint = pieces::GetFootprint(type, static_cast<int>(currentRotation) / 90);
+	return (footprint.rows[y] >> x) & 1u;
 }
 
-void Tetromino::CheckCollisionBeforeRotation()
+template<typename BoardType>
+void BasicTetromino<BoardType>::CheckCollisionBeforeRotation(Rotation previousRotation)
 {
 	// Save the original position
 	Vec2<int> originalPos = pos;
 
-	// Define the offset sequence to try (wall kick)
-	const std::vector<Vec2<int>> offsets = {
-		Vec2<int>(0, 0),    // No offset (check if it already fits)
-		Vec2<int>(1, 0),    // Right by 1
-		Vec2<int>(-1, 0),   // Left by 1
-		Vec2<int>(2, 0),    // Right by 2
-		Vec2<int>(-2, 0)    // Left by 2
-	};
-
-	// Try each offset
-	for (const auto& offset : offsets)
+	// Try each wall kick offset for this piece and turn
+	const pieces::KickList& kicks = pieces::GetKicks(type, static_cast<int>(previousRotation) / 90, static_cast<int>(currentRotation) / 90);
+	for (int i = 0; i < kicks.count; ++i)
 	{
-		pos = originalPos + offset;
+		const pieces::Kick& kick = kicks.kicks[i];
+		pos = originalPos + Vec2<int>(kick.x, kick.y);
 		if (!IsCollidingWithBoard())
 			return;  // Success! We found a position that works
 	}
 
-	// If all offsets failed, revert to the original position
+	// If all offsets failed, the rotation doesn't happen
 	pos = originalPos;
+	currentRotation = previousRotation;
 }
 
-bool Tetromino::IsCollidingWithBoard() const {
-	for (int y = 0; y < dimension; ++y) {
-		for (int x = 0; x < dimension; ++x) {
-			if (IsCellAt(x, y)) {
-				Vec2<int> cellPos = pos + Vec2<int>(x, y);
-				if (cellPos.GetX() < 0 || cellPos.GetX() >= board.GetWidth() ||
-					cellPos.GetY() < 0 || cellPos.GetY() >= board.GetHeight() ||
-					board.CellExists(cellPos)) {
-					return true;
-				}
-			}
+template<typename BoardType>
+bool BasicTetromino<BoardType>::IsCollidingWithBoard() const {
+	// The walls and floor bound the footprint, then each of its rows is one mask test
+	const pieces::Footprint& f = pieces::GetFootprint(type, static_cast<int>(currentRotation) / 90);
+	const int x = pos.GetX();
+	const int y = pos.GetY();
+	if (x + f.minX < 0 || x + f.maxX >= board.GetWidth() || y + f.minY < 0 || y + f.maxY >= board.GetHeight()) {
+		return true;
+	}
+	for (int r = f.minY; r <= f.maxY; ++r) {
+		const uint32_t row = x >= 0 ? f.rows[r] << x : f.rows[r] >> -x;
+		if (board.GetRowMask(y + r) & row) {
+			return true;
 		}
 	}
 	return false;
 }
 
-void Tetromino::Update(float deltaTime) {
+template<typename BoardType>
+void BasicTetromino<BoardType>::Tick(int32_t gravity) {
 	if (hasLanded) {
 		return;
 	}
 
-	timeSinceLastMove += deltaTime;
+	gravityAccumulator += gravity;
 
-	if (timeSinceLastMove >= moveInterval) {
-		timeSinceLastMove = 0.0f;
+	// Fall one row per whole row accumulated, several per tick at high gravity
+	while (gravityAccumulator >= gravity::oneRow) {
+		gravityAccumulator -= gravity::oneRow;
 
 		pos += Vec2<int>(0, 1);
 
@@ -120,78 +120,159 @@ void Tetromino::Update(float deltaTime) {
 			// Revert the position if collision detected
 			pos -= Vec2<int>(0, 1);
 			hasLanded = true;
+			gravityAccumulator = 0;
 		}
+		++revision;
 	}
 }
 
 
-void Tetromino::RotateClockwise()
+template<typename BoardType>
+void BasicTetromino<BoardType>::RotateClockwise()
 {
+	const Rotation previousRotation = currentRotation;
 	currentRotation = static_cast<Rotation>((static_cast<int>(currentRotation) + 90) % 360);
-	CheckCollisionBeforeRotation();
+	CheckCollisionBeforeRotation(previousRotation);
+	++revision;
 }
 
-void Tetromino::RotateCounterClockwise()
+template<typename BoardType>
+void BasicTetromino<BoardType>::RotateCounterClockwise()
 {
+	const Rotation previousRotation = currentRotation;
 	if (currentRotation == Rotation::Zero)
 	{
 		currentRotation = Rotation::TwoSeventy;
-		CheckCollisionBeforeRotation();
+		CheckCollisionBeforeRotation(previousRotation);
+		++revision;
 		return;
 	}
 	currentRotation = static_cast<Rotation>((static_cast<int>(currentRotation) - 90) % 360);
-	CheckCollisionBeforeRotation();
+	CheckCollisionBeforeRotation(previousRotation);
+	++revision;
 }
 
-void Tetromino::MoveLeft() {
+template<typename BoardType>
+void BasicTetromino<BoardType>::MoveLeft() {
 	pos += Vec2<int>(-1, 0); // Move the Tetromino left
 
 	if (IsCollidingWithBoard()) {
 		pos -= Vec2<int>(-1, 0); // Revert the position if collision detected
 	}
+	else {
+		++revision;
+	}
 }
 
-void Tetromino::MoveRight() {
+template<typename BoardType>
+void BasicTetromino<BoardType>::MoveRight() {
 	pos += Vec2<int>(1, 0); // Move the Tetromino right
 
 	if (IsCollidingWithBoard()) {
 		pos -= Vec2<int>(1, 0); // Revert the position if collision detected
 	}
+	else {
+		++revision;
+	}
 }
 
 
-void Tetromino::Drop() {
+template<typename BoardType>
+void BasicTetromino<BoardType>::Drop() {
 	pos += Vec2<int>(0, 1); // Move the Tetromino down
 
 	if (IsCollidingWithBoard()) {
 		pos -= Vec2<int>(0, 1); // Revert the position if collision detected
 	}
+	else {
+		++revision;
+	}
 }
 
-void Tetromino::SetDropInterval(float interval)
-{
-	moveInterval = interval;
+template<typename BoardType>
+void BasicTetromino<BoardType>::AddToBoard() const {
+	for (int y = 0; y < dimension; ++y) {
+		for (int x = 0; x < dimension; ++x) {
+			if (IsCellAt(x, y)) {
+				board.SetCell(pos + Vec2<int>(x, y), color);
+			}
+		}
+	}
 }
 
-void Tetromino::AddToBoard() const {
+template<typename BoardType>
+void BasicTetromino<BoardType>::EmitLockParticles(ParticleSystem& particles) const
+{
 	for (int y = 0; y < dimension; ++y) {
 		for (int x = 0; x < dimension; ++x) {
 			if (IsCellAt(x, y)) {
-				board.SetCell(pos + Vec2<int>(x, y), color);
+				board.EmitCellParticles(pos + Vec2<int>(x, y), color, particles, settings::lockParticlesPerCell);
 			}
 		}
 	}
 }
 
-bool Tetromino::HasLanded() const
+template<typename BoardType>
+bool BasicTetromino<BoardType>::HasLanded() const
 {
 	return hasLanded;
 }
 
-void Tetromino::Reset()
+template<typename BoardType>
+void BasicTetromino<BoardType>::Reset()
 {
-	pos = Vec2<int>(board.GetWidth() / 2 - dimension / 2, 0);
+	pos = Vec2<int>(pieces::SpawnX(type, board.GetWidth()), 0);
 	hasLanded = false;
-	timeSinceLastMove = 0.0f;
+	gravityAccumulator = 0;
 	currentRotation = Rotation::Zero;
+	++revision;
 }
+
+template<typename BoardType>
+unsigned int BasicTetromino<BoardType>::GetRevision() const
+{
+	return revision;
+}
+
+template<typename BoardType>
+PieceType BasicTetromino<BoardType>::GetType() const
+{
+	return type;
+}
+
+template<typename BoardType>
+uint64_t BasicTetromino<BoardType>::GetHash() const
+{
+	return zobrist::PieceKey(type, static_cast<int>(currentRotation) / 90, pos.GetX(), pos.GetY());
+}
+
+template<typename BoardType>
+Color BasicTetromino<BoardType>::GetColor() const
+{
+	return color;
+}
+
+template<typename BoardType>
+Color BasicTetromino<BoardType>::GetColor(PieceType type)
+{
+	return pieceColors[static_cast<int>(type)];
+}
+
+template<typename BoardType>
+typename BasicTetromino<BoardType>::State BasicTetromino<BoardType>::GetState() const
+{
+	return { pos, currentRotation, gravityAccumulator };
+}
+
+template<typename BoardType>
+void BasicTetromino<BoardType>::SetState(const State& state)
+{
+	pos = state.pos;
+	currentRotation = state.rotation;
+	gravityAccumulator = state.gravityAccumulator;
+	hasLanded = false;
+	++revision;
+}
+
+template class BasicTetromino<Board>;
+template class BasicTetromino<DynamicBoard>;
@@ -1,10 +1,14 @@
 #pragma once
 #include <assert.h>
+#include <cstdint>
 #include "Vec2.h"
 #include "raylibCpp.h"
 #include "Board.h"
+#include "Pieces.h"
 
-class Tetromino
+// A falling piece on a board of either kind, BasicBoard<> for custom sizes
+template<typename BoardType>
+class BasicTetromino
 {
 public:
 	enum class Rotation
@@ -14,155 +18,48 @@ public:
 		OneEighty = 180,
 		TwoSeventy = 270
 	};
+	struct State
+	{
+		Vec2<int> pos;
+		Rotation rotation;
+		int32_t gravityAccumulator;
+	};
 public:
-	Tetromino(const bool* shape, int dimension, Color color, Board& board);
+	BasicTetromino(PieceType type, BoardType& board);
+	static Color GetColor(PieceType type);
 	void Draw() const;
-	void Update(float deltaTime);
+	void Tick(int32_t gravity);
 	void RotateClockwise();
 	void RotateCounterClockwise();
 	void MoveLeft();
 	void MoveRight();
 	void Drop();
-	void SetDropInterval(float interval);
 	void AddToBoard() const;
+	void EmitLockParticles(ParticleSystem& particles) const;
 	bool HasLanded() const;
 	void Reset();
+	unsigned int GetRevision() const;
+	PieceType GetType() const;
+	// Zobrist key of the type, position and rotation
+	uint64_t GetHash() const;
+	Color GetColor() const;
+	State GetState() const;
+	void SetState(const State& state);
 private:
 	Vec2<int> pos;
 	Vec2<int> GetLastPos() const;
 	bool IsCellAt(int x, int y) const;
-	void CheckCollisionBeforeRotation();
+	void CheckCollisionBeforeRotation(Rotation previousRotation);
 	bool IsCollidingWithBoard() const;
 	Rotation currentRotation;
 	bool hasLanded;
-	float timeSinceLastMove;
-	float moveInterval;
-	const bool* shape;
+	int32_t gravityAccumulator;	// Fixed point, see Gravity.h
+	unsigned int revision = 0;	// Bumped whenever the piece moves, rotates or lands
+	const PieceType type;
 	const int dimension;
 	const Color color;
-	Board& board;
-};
-
-class StraightTetromino : public Tetromino
-{
-public:
-	StraightTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] =
-	{ 0,0,0,0,
-	1,1,1,1,
-	0,0,0,0,
-	0,0,0,0 };
-	static constexpr Color color = BLUE;
-	static constexpr int dimension = 4;
-};
-
-class SquareTetromino : public Tetromino
-{
-public:
-	SquareTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-			1,1,1,1
-	};
-	static constexpr Color color = YELLOW;
-	static constexpr int dimension = 2;
-};
-
-class TeeTetromino : public Tetromino
-{
-public:
-	TeeTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-			0,1,0,
-			1,1,1,
-			0,0,0
-	};
-	static constexpr Color color = PURPLE;
-	static constexpr int dimension = 3;
-};
-
-class JayTetromino : public Tetromino
-{
-public:
-	JayTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-			1,0,0,
-			1,1,1,
-			0,0,0
-	};
-	static constexpr Color color = ORANGE;
-	static constexpr int dimension = 3;
-};
-
-class EllTetromino : public Tetromino
-{
-public:
-	EllTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-			0,0,1,
-			1,1,1,
-			0,0,0
-	};
-	static constexpr Color color = GREEN;
-	static constexpr int dimension = 3;
+	BoardType& board;
 };
 
-class SkewSTetromino : public Tetromino
-{
-public:
-	SkewSTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-			0,1,1,
-			1,1,0,
-			0,0,0
-	};
-	static constexpr Color color = RED;
-	static constexpr int dimension = 3;
-};
-
-class SkewZTetromino : public Tetromino
-{
-public:
-	SkewZTetromino(Board& board)
-		: Tetromino(shape, dimension, color, board)
-	{
-		static_assert(sizeof(shape) / sizeof(bool) == dimension * dimension);
-	}
-private:
-	static constexpr bool shape[] = {
-		1,1,0,
-		0,1,1,
-		0,0,0
-	};
-	static constexpr Color color = MAROON;
-	static constexpr int dimension = 3;
-};
\ No newline at end of file
+using Tetromino = BasicTetromino<Board>;
+using DynamicTetromino = BasicTetromino<DynamicBoard>;
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "TrainingExport.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <assert.h>
+#include "Heuristics.h"
+#include "Zobrist.h"
+
+namespace
+{
+	constexpr size_t pageSize = 4096;
+
+	struct ColumnType
+	{
+		const char* name;
+		const char* dtype;
+		int elementSize;
+		int elements;
+	};
+	// In the order of TrainingExport::Column
+	constexpr ColumnType columnTypes[] =
+	{
+		{ "rows", "<u4", 4, TrainingExport::height },
+		{ "piece", "|u1", 1, 1 },
+		{ "preview", "|u1", 1, TrainingExport::previewCount },
+		{ "x", "|i1", 1, 1 },
+		{ "y", "|i1", 1, 1 },
+		{ "rotation", "|u1", 1, 1 },
+		{ "cleared", "|u1", 1, 1 },
+		{ "outcome", "|u1", 1, 1 },
+		{ "game", "<u8", 8, 1 },
+		{ "lock", "<u4", 4, 1 }
+	};
+
+	size_t RoundUpToPage(size_t size)
+	{
+		return (size + pageSize - 1) / pageSize * pageSize;
+	}
+}
+
+bool TrainingExport::Run(const std::string& path, uint64_t rowCount, uint64_t seed, int threadCount)
+{
+	static_assert(sizeof(columnTypes) / sizeof(columnTypes[0]) == columnCount);
+	static_assert(width <= 8 * sizeof(uint32_t));
+	assert(rowCount > 0 && threadCount >= 1);
+	this->rowCount = rowCount;
+	this->threadCount = threadCount;
+
+	size_t size = RoundUpToPage(sizeof(FileHeader) + sizeof(ColumnHeader) * columnCount);
+	for (int c = 0; c < columnCount; ++c)
+	{
+		ColumnHeader& column = columns[c];
+		column = {};
+		std::strncpy(column.name, columnTypes[c].name, sizeof(column.name) - 1);
+		std::strncpy(column.dtype, columnTypes[c].dtype, sizeof(column.dtype) - 1);
+		column.elements = columnTypes[c].elements;
+		column.offset = size;
+		size += RoundUpToPage(rowCount * columnTypes[c].elementSize * columnTypes[c].elements);
+	}
+	// Mapping only ever grows a file, an older and larger export would leave its tail behind
+	std::remove(path.c_str());
+	if (!file.Open(path, size))
+		return false;
+
+	FileHeader header = { magic, version, 0, seed, width, height, columnCount, 0 };
+	std::memcpy(file.GetData(), &header, sizeof(header));
+	std::memcpy(file.GetData() + sizeof(header), columns.data(), sizeof(ColumnHeader) * columnCount);
+
+	workers.clear();
+	for (int i = 0; i < threadCount; ++i)
+	{
+		Worker& worker = *workers.emplace_back(std::make_unique<Worker>());
+		worker.randomizer.Seed(zobrist::Mix(seed + i));
+		worker.gameCount = 0;
+		StartGame(worker, i);
+	}
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back([this, i]() { RunWorker(*workers[i], i); });
+	}
+	RunWorker(*workers[0], 0);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	header.rowCount = rowCount;
+	std::memcpy(file.GetData(), &header, sizeof(header));
+	file.Flush(false);
+	file.Close();
+	return true;
+}
+
+uint64_t TrainingExport::GetGameCount() const
+{
+	uint64_t count = 0;
+	for (const std::unique_ptr<Worker>& worker : workers)
+	{
+		count += worker->gameCount;
+	}
+	return count;
+}
+
+void TrainingExport::RunWorker(Worker& worker, int index)
+{
+	constexpr int chunkRows = settings::exportChunkRows;
+	Chunk& chunk = worker.chunk;
+	chunk.rows.resize(chunkRows * height);
+	chunk.pieces.resize(chunkRows);
+	chunk.previews.resize(chunkRows * previewCount);
+	chunk.xs.resize(chunkRows);
+	chunk.ys.resize(chunkRows);
+	chunk.rotations.resize(chunkRows);
+	chunk.cleared.resize(chunkRows);
+	chunk.outcomes.resize(chunkRows);
+	chunk.games.resize(chunkRows);
+	chunk.locks.resize(chunkRows);
+
+	for (uint64_t firstRow = static_cast<uint64_t>(index) * chunkRows; firstRow < rowCount;
+		firstRow += static_cast<uint64_t>(threadCount) * chunkRows)
+	{
+		const int rows = static_cast<int>(std::min<uint64_t>(chunkRows, rowCount - firstRow));
+		for (int i = 0; i < rows; ++i)
+		{
+			PlayLock(worker, index, i);
+		}
+		WriteChunk(chunk, firstRow, rows);
+	}
+}
+
+void TrainingExport::StartGame(Worker& worker, int index)
+{
+	// Like VecEnv, a new game carries on the piece sequence of the last one
+	worker.rows.fill(0);
+	worker.type = worker.randomizer.Next();
+	worker.game = worker.gameCount++ * threadCount + index;
+	worker.lock = 0;
+	const PathPlanner::Placement spawn = { pieces::SpawnX(worker.type, width), 0, 0 };
+	const bool hasPlacements = worker.planner.Search(worker.rows.data(), width, height, worker.type, spawn);
+	assert(hasPlacements);
+	(void)hasPlacements;
+}
+
+void TrainingExport::PlayLock(Worker& worker, int index, int i)
+{
+	Chunk& chunk = worker.chunk;
+	PathPlanner& planner = worker.planner;
+	std::copy(worker.rows.begin(), worker.rows.end(), chunk.rows.begin() + i * height);
+	PieceRandomizer preview = worker.randomizer;
+	for (int p = 0; p < previewCount; ++p)
+	{
+		chunk.previews[i * previewCount + p] = static_cast<uint8_t>(preview.Next());
+	}
+
+	// The planner already holds this piece's placements, the greedy bot takes the best board
+	std::array<uint32_t, height> next;
+	int best = -1;
+	int bestScore = 0;
+	int bestCleared = 0;
+	for (int p = 0; p < planner.GetPlacementCount(); ++p)
+	{
+		next = worker.rows;
+		const int cleared = heuristics::ApplyPlacement(next.data(), width, height, worker.type, planner.GetPlacement(p));
+		const int score = heuristics::ScoreBoard(next.data(), width, height, cleared);
+		if (best < 0 || score > bestScore)
+		{
+			best = p;
+			bestScore = score;
+			bestCleared = cleared;
+		}
+	}
+	assert(best >= 0);
+	const PathPlanner::Placement placement = planner.GetPlacement(best);
+	heuristics::ApplyPlacement(worker.rows.data(), width, height, worker.type, placement);
+
+	chunk.pieces[i] = static_cast<uint8_t>(worker.type);
+	chunk.xs[i] = static_cast<int8_t>(placement.x);
+	chunk.ys[i] = static_cast<int8_t>(placement.y);
+	chunk.rotations[i] = static_cast<uint8_t>(placement.rotation);
+	chunk.cleared[i] = static_cast<uint8_t>(bestCleared);
+	chunk.games[i] = worker.game;
+	chunk.locks[i] = worker.lock++;
+
+	// Searching the next piece now tells whether the game ends with this lock
+	worker.type = worker.randomizer.Next();
+	const PathPlanner::Placement spawn = { pieces::SpawnX(worker.type, width), 0, 0 };
+	Outcome outcome = Outcome::Continued;
+	if (worker.rows[0] != 0 || !planner.Search(worker.rows.data(), width, height, worker.type, spawn) || planner.GetPlacementCount() == 0)
+	{
+		outcome = Outcome::ToppedOut;
+	}
+	else if (worker.lock == settings::exportMaxLocksPerGame)
+	{
+		outcome = Outcome::CutOff;
+	}
+	chunk.outcomes[i] = static_cast<uint8_t>(outcome);
+	if (outcome != Outcome::Continued)
+	{
+		StartGame(worker, index);
+	}
+}
+
+void TrainingExport::WriteChunk(const Chunk& chunk, uint64_t firstRow, int chunkRows)
+{
+	const void* sources[columnCount] =
+	{
+		chunk.rows.data(), chunk.pieces.data(), chunk.previews.data(), chunk.xs.data(), chunk.ys.data(),
+		chunk.rotations.data(), chunk.cleared.data(), chunk.outcomes.data(), chunk.games.data(), chunk.locks.data()
+	};
+	for (int c = 0; c < columnCount; ++c)
+	{
+		const size_t stride = static_cast<size_t>(columnTypes[c].elementSize) * columnTypes[c].elements;
+		std::memcpy(file.GetData() + columns[c].offset + firstRow * stride, sources[c], chunkRows * stride);
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Pieces.h"
+#include "PathPlanner.h"
+#include "MappedFile.h"
+#include "VecEnv.h"
+#include "Settings.h"
+
+// Headless bot games on every core, logged lock by lock into a columnar file for
+// training. Every column is one fixed-stride array sized for the requested row count,
+// page aligned in a single memory-mapped file. Each worker fills a chunk of rows per
+// column in memory and copies it into the mapping in one piece, so nothing is ever
+// formatted and the disk sees large sequential writes. Worker w writes chunks w, w +
+// threads and so on, which makes the file depend only on the seed and thread count.
+//
+// The file starts with a FileHeader and columnCount ColumnHeaders, all little endian.
+// rowCount is written last, so an interrupted export reads as empty. With numpy dtypes
+// matching the two structs, every column c maps without parsing:
+//   header = np.fromfile(path, headerDtype, 1)[0]
+//   columns = np.fromfile(path, columnDtype, header['columnCount'], offset=headerDtype.itemsize)
+//   np.memmap(path, c['dtype'].decode(), 'r', int(c['offset']), (int(header['rowCount']), int(c['elements'])))
+class TrainingExport
+{
+public:
+	static constexpr int width = VecEnv::width;
+	static constexpr int height = VecEnv::height;
+	static constexpr int previewCount = settings::exportPreviewPieces;
+
+	// How the game went on after the lock
+	enum class Outcome : uint8_t
+	{
+		Continued,
+		ToppedOut,
+		CutOff	// Reached settings::exportMaxLocksPerGame
+	};
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t rowCount;
+		uint64_t seed;
+		uint32_t width;
+		uint32_t height;
+		uint32_t columnCount;
+		uint32_t reserved;
+	};
+	struct ColumnHeader
+	{
+		char name[16];
+		char dtype[8];	// numpy type string
+		uint32_t elements;	// Per row
+		uint32_t reserved;
+		uint64_t offset;
+	};
+	static constexpr uint32_t magic = 0x4E525454;	// "TTRN"
+	static constexpr uint32_t version = 1;
+public:
+	// Plays games until rowCount locks are recorded. False if the file can't be created.
+	bool Run(const std::string& path, uint64_t rowCount, uint64_t seed, int threadCount);
+	uint64_t GetGameCount() const;
+private:
+	enum Column
+	{
+		Rows,	// Board before the lock, row masks with row 0 on top
+		Piece,
+		Preview,	// The next previewCount pieces
+		PlacementX,
+		PlacementY,
+		PlacementRotation,
+		Cleared,
+		Result,	// Outcome
+		Game,	// Unique per game in the file
+		Lock,	// Locks before this one in the game
+		columnCount
+	};
+	struct Chunk
+	{
+		std::vector<uint32_t> rows;
+		std::vector<uint8_t> pieces;
+		std::vector<uint8_t> previews;
+		std::vector<int8_t> xs;
+		std::vector<int8_t> ys;
+		std::vector<uint8_t> rotations;
+		std::vector<uint8_t> cleared;
+		std::vector<uint8_t> outcomes;
+		std::vector<uint64_t> games;
+		std::vector<uint32_t> locks;
+	};
+	struct Worker
+	{
+		PathPlanner planner;
+		Chunk chunk;
+		std::array<uint32_t, height> rows;
+		PieceRandomizer randomizer;
+		PieceType type;
+		uint64_t game;
+		uint32_t lock;
+		uint64_t gameCount;
+	};
+
+	void RunWorker(Worker& worker, int index);
+	void StartGame(Worker& worker, int index);
+	// Plays one lock into row i of the worker's chunk
+	void PlayLock(Worker& worker, int index, int i);
+	void WriteChunk(const Chunk& chunk, uint64_t firstRow, int chunkRows);
+private:
+	MappedFile file;
+	std::array<ColumnHeader, columnCount> columns;
+	uint64_t rowCount = 0;
+	int threadCount = 1;
+	std::vector<std::unique_ptr<Worker>> workers;
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-off of the latest value from one producer thread to one consumer thread.
+// The producer always has a buffer to write into and the consumer always has a complete
+// one to read, a third buffer in the middle is swapped between them. Values the
+// consumer did not get to in time are overwritten, only the newest one is kept.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer side, fill the write buffer completely, then publish it
+	T& GetWriteBuffer()
+	{
+		return buffers[writeIndex];
+	}
+	void Publish()
+	{
+		const uint8_t previous = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel);
+		writeIndex = previous & indexMask;
+	}
+
+	// Consumer side, returns true if a newer value became the read buffer
+	bool Fetch()
+	{
+		if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			return false;
+		const uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & indexMask;
+		return true;
+	}
+	const T& GetReadBuffer() const
+	{
+		return buffers[readIndex];
+	}
+private:
+	static constexpr uint8_t indexMask = 0x3;
+	static constexpr uint8_t freshBit = 0x4;
+
+	std::array<T, 3> buffers = {};
+	std::atomic<uint8_t> middle = 1;
+	uint8_t writeIndex = 0;	// Only touched by the producer
+	uint8_t readIndex = 2;	// Only touched by the consumer
+};
\ No newline at end of file
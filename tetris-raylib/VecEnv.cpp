@@ -0,0 +1,228 @@
+#include "VecEnv.h"
+#include <assert.h>
+#include <algorithm>
+#include "Gravity.h"
+
+namespace
+{
+	constexpr uint32_t fullRowMask = (1u << VecEnv::width) - 1;
+	static_assert(VecEnv::width < 32, "Rows have to fit in a 32 bit mask");
+
+	uint32_t ShiftRow(uint32_t row, int x)
+	{
+		return x >= 0 ? row << x : row >> -x;
+	}
+}
+
+VecEnv::VecEnv(int count, const VecEnvBuffers& buffers)
+	: count(count), buffers(buffers)
+{
+	assert(count > 0);
+	assert(buffers.rows && buffers.pieceType && buffers.pieceX && buffers.pieceY && buffers.pieceRotation);
+	assert(buffers.rewards && buffers.dones);
+	randomizerStates.resize(count);
+	gravityAccumulators.resize(count);
+	elapsedTicks.resize(count);
+	speedLevels.resize(count);
+	spawnCounts.resize(count);
+}
+
+int VecEnv::GetCount() const
+{
+	return count;
+}
+
+uint32_t VecEnv::GetSpawnCount(int i) const
+{
+	assert(i >= 0 && i < count);
+	return spawnCounts[i];
+}
+
+uint64_t VecEnv::GetRandomizerState(int i) const
+{
+	assert(i >= 0 && i < count);
+	return randomizerStates[i];
+}
+
+void VecEnv::Reset(const uint64_t* seeds)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		ResetGame(i, seeds[i]);
+	}
+}
+
+void VecEnv::Step(const uint8_t* actions)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		buffers.rewards[i] = 0.0f;
+		buffers.dones[i] = 0;
+		if (actions[i] < static_cast<uint8_t>(EnvAction::Count))
+		{
+			ApplyAction(i, static_cast<EnvAction>(actions[i]));
+		}
+
+		// Same order as Simulation::StepGameplay
+		if (++elapsedTicks[i] >= settings::ticksPerLevel * speedLevels[i])
+		{
+			++speedLevels[i];
+		}
+
+		gravityAccumulators[i] += gravity::ForLevel(speedLevels[i]);
+		bool hasLanded = false;
+		while (gravityAccumulators[i] >= gravity::oneRow)
+		{
+			gravityAccumulators[i] -= gravity::oneRow;
+			if (Fits(i, buffers.pieceType[i], buffers.pieceRotation[i], buffers.pieceX[i], buffers.pieceY[i] + 1))
+			{
+				++buffers.pieceY[i];
+			}
+			else
+			{
+				hasLanded = true;
+				gravityAccumulators[i] = 0;
+			}
+		}
+		if (!hasLanded)
+			continue;
+
+		LockPiece(i);
+		const int cleared = ClearLines(i);
+		buffers.rewards[i] = static_cast<float>(settings::lineClearScores[std::min(cleared, 4)] * speedLevels[i]);
+		SpawnPiece(i);
+
+		if (buffers.rows[i * height] != 0)
+		{
+			// Topped out, carry on with a new game seeded from where the piece sequence left off
+			buffers.dones[i] = 1;
+			ResetGame(i, randomizerStates[i]);
+		}
+	}
+}
+
+void VecEnv::ResetGame(int i, uint64_t seed)
+{
+	std::fill_n(buffers.rows + i * height, height, 0u);
+	randomizerStates[i] = seed;
+	gravityAccumulators[i] = 0;
+	elapsedTicks[i] = 0;
+	speedLevels[i] = settings::initialLevel;
+	SpawnPiece(i);
+}
+
+void VecEnv::SpawnPiece(int i)
+{
+	PieceRandomizer randomizer;
+	randomizer.SetState(randomizerStates[i]);
+	const PieceType type = randomizer.Next();
+	randomizerStates[i] = randomizer.GetState();
+
+	buffers.pieceType[i] = static_cast<int32_t>(type);
+	buffers.pieceX[i] = pieces::SpawnX(type, width);
+	buffers.pieceY[i] = 0;
+	buffers.pieceRotation[i] = 0;
+	gravityAccumulators[i] = 0;
+	++spawnCounts[i];
+}
+
+bool VecEnv::Fits(int i, int type, int rotation, int x, int y) const
+{
+	const pieces::Footprint& f = pieces::GetFootprint(static_cast<PieceType>(type), rotation);
+	if (x + f.minX < 0 || x + f.maxX >= width || y + f.minY < 0 || y + f.maxY >= height)
+		return false;
+
+	const uint32_t* rows = buffers.rows + i * height + y;
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		if (rows[r] & ShiftRow(f.rows[r], x))
+			return false;
+	}
+	return true;
+}
+
+void VecEnv::ApplyAction(int i, EnvAction action)
+{
+	const int type = buffers.pieceType[i];
+	const int rotation = buffers.pieceRotation[i];
+	switch (action)
+	{
+	case EnvAction::MoveLeft:
+		if (Fits(i, type, rotation, buffers.pieceX[i] - 1, buffers.pieceY[i]))
+			--buffers.pieceX[i];
+		break;
+	case EnvAction::MoveRight:
+		if (Fits(i, type, rotation, buffers.pieceX[i] + 1, buffers.pieceY[i]))
+			++buffers.pieceX[i];
+		break;
+	case EnvAction::RotateClockwise:
+		Rotate(i, 1);
+		break;
+	case EnvAction::RotateCounterClockwise:
+		Rotate(i, pieces::rotationCount - 1);
+		break;
+	case EnvAction::Drop:
+		if (Fits(i, type, rotation, buffers.pieceX[i], buffers.pieceY[i] + 1))
+			++buffers.pieceY[i];
+		break;
+	default:
+		break;
+	}
+}
+
+void VecEnv::Rotate(int i, int turn)
+{
+	const int type = buffers.pieceType[i];
+	const int rotation = (buffers.pieceRotation[i] + turn) % pieces::rotationCount;
+	const pieces::KickList& kicks = pieces::GetKicks(static_cast<PieceType>(type), buffers.pieceRotation[i], rotation);
+	for (int k = 0; k < kicks.count; ++k)
+	{
+		const pieces::Kick& kick = kicks.kicks[k];
+		const int x = buffers.pieceX[i] + kick.x;
+		const int y = buffers.pieceY[i] + kick.y;
+		if (Fits(i, type, rotation, x, y))
+		{
+			buffers.pieceX[i] = x;
+			buffers.pieceY[i] = y;
+			buffers.pieceRotation[i] = rotation;
+			return;
+		}
+	}
+}
+
+void VecEnv::LockPiece(int i)
+{
+	const pieces::Footprint& f = pieces::GetFootprint(static_cast<PieceType>(buffers.pieceType[i]), buffers.pieceRotation[i]);
+	uint32_t* rows = buffers.rows + i * height + buffers.pieceY[i];
+	for (int r = f.minY; r <= f.maxY; ++r)
+	{
+		rows[r] |= ShiftRow(f.rows[r], buffers.pieceX[i]);
+	}
+}
+
+int VecEnv::ClearLines(int i)
+{
+	uint32_t* rows = buffers.rows + i * height;
+	// Only the rows the piece just locked into can have become full
+	const pieces::Footprint& f = pieces::GetFootprint(static_cast<PieceType>(buffers.pieceType[i]), buffers.pieceRotation[i]);
+	const int top = buffers.pieceY[i] + f.minY;
+	const int bottom = buffers.pieceY[i] + f.maxY;
+	bool hasFullRow = false;
+	for (int y = top; y <= bottom; ++y)
+	{
+		hasFullRow |= rows[y] == fullRowMask;
+	}
+	if (!hasFullRow)
+		return 0;
+
+	int write = bottom;
+	for (int read = bottom; read >= 0; --read)
+	{
+		if (read >= top && rows[read] == fullRowMask)
+			continue;
+		rows[write--] = rows[read];
+	}
+	const int cleared = write + 1;
+	std::fill_n(rows, cleared, 0u);
+	return cleared;
+}
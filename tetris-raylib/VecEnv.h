@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Pieces.h"
+#include "Settings.h"
+#include "TetrisEnv.h"
+
+// Headless batch of games for reinforcement learning, stepped in lockstep. Follows
+// the same rules as Simulation (shared pieces, kicks, gravity and scoring) but keeps
+// each board as row bitmasks and every per-game field as its own array across the
+// batch. Boards and pieces live directly in caller-provided buffers, so the
+// observation after a step is already in place and nothing is copied.
+//
+// A step applies one action and then one gravity tick. A game that tops out
+// reports done and is reset in the same step, its next observation is the new game.
+// TetrisEnv.h has the observation buffers and the C interface for training code.
+
+enum class EnvAction : uint8_t
+{
+	None,
+	MoveLeft,
+	MoveRight,
+	RotateClockwise,
+	RotateCounterClockwise,
+	Drop,
+	Count
+};
+
+class VecEnv
+{
+public:
+	static constexpr int width = settings::boardWidthHeight.GetX();
+	static constexpr int height = settings::boardWidthHeight.GetY();
+public:
+	VecEnv(int count, const VecEnvBuffers& buffers);
+	void Reset(const uint64_t* seeds);
+	void Step(const uint8_t* actions);
+	int GetCount() const;
+	// Pieces spawned so far in game i, changes exactly when a new piece appears
+	uint32_t GetSpawnCount(int i) const;
+	// Every upcoming piece of game i follows from it, as for PieceRandomizer
+	uint64_t GetRandomizerState(int i) const;
+private:
+	void ResetGame(int i, uint64_t seed);
+	void SpawnPiece(int i);
+	bool Fits(int i, int type, int rotation, int x, int y) const;
+	void ApplyAction(int i, EnvAction action);
+	void Rotate(int i, int turn);
+	void LockPiece(int i);
+	int ClearLines(int i);
+private:
+	const int count;
+	VecEnvBuffers buffers;
+	// Per-game state that isn't part of the observation
+	std::vector<uint64_t> randomizerStates;
+	std::vector<int32_t> gravityAccumulators;
+	std::vector<int32_t> elapsedTicks;
+	std::vector<int32_t> speedLevels;
+	std::vector<uint32_t> spawnCounts;
+};
\ No newline at end of file
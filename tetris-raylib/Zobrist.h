@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include "Pieces.h"
+#include "GameSnapshot.h"
+
+// 64 bit Zobrist style hashing of a game position. Keys come from a mixer instead of
+// a random table, so they are the same in every build and can be computed at compile time.
+// A row's key is the key of its occupancy rotated left by its row index, so shifting
+// every row of the board by one is a single rotation of the board hash.
+namespace zobrist
+{
+	inline constexpr uint64_t rowSalt = 0x9e3779b97f4a7c15ull;
+	inline constexpr uint64_t pieceSalt = 0xc2b2ae3d27d4eb4full;
+	inline constexpr uint64_t sequenceSalt = 0x165667b19e3779f9ull;
+	inline constexpr uint64_t previewSalt = 0x27d4eb2f165667c5ull;
+	inline constexpr int maxRows = 64;	// Row keys repeat after a full rotation
+
+	// SplitMix64 finalizer
+	constexpr uint64_t Mix(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	constexpr uint64_t RotateLeft(uint64_t v, int n)
+	{
+		n &= 63;
+		return n == 0 ? v : (v << n) | (v >> (64 - n));
+	}
+
+	constexpr uint64_t RotateRight(uint64_t v, int n)
+	{
+		return RotateLeft(v, 64 - (n & 63));
+	}
+
+	// Empty rows hash to zero, so an empty board does too
+	constexpr uint64_t RowKey(uint32_t mask)
+	{
+		return mask == 0 ? 0 : Mix(mask ^ rowSalt);
+	}
+
+	constexpr uint64_t RowKey(int y, uint32_t mask)
+	{
+		return RotateLeft(RowKey(mask), y);
+	}
+
+	// The falling piece, rotation in quarter turns
+	constexpr uint64_t PieceKey(PieceType type, int rotation, int x, int y)
+	{
+		const uint64_t packed = static_cast<uint64_t>(type) | static_cast<uint64_t>(rotation & 3) << 8 |
+			static_cast<uint64_t>(static_cast<uint16_t>(x)) << 16 | static_cast<uint64_t>(static_cast<uint16_t>(y)) << 32;
+		return Mix(packed ^ pieceSalt);
+	}
+
+	// The randomizer state decides every upcoming piece, so it stands for the preview
+	constexpr uint64_t SequenceKey(uint64_t randomizerState)
+	{
+		return Mix(randomizerState ^ sequenceSalt);
+	}
+
+	// A single upcoming piece, index 0 is the next one. For keys that only depend on a
+	// few pieces of the preview rather than on the whole sequence.
+	constexpr uint64_t PreviewKey(PieceType type, int index)
+	{
+		return Mix((static_cast<uint64_t>(type) | static_cast<uint64_t>(index) << 8) ^ previewSalt);
+	}
+
+	// Same hash as the live state the snapshot was captured from, its rotation is in degrees
+	constexpr uint64_t HashSnapshot(const GameSnapshot& snapshot)
+	{
+		uint64_t hash = 0;
+		for (int y = 0; y < GameSnapshot::height; ++y)
+		{
+			hash ^= RowKey(y, snapshot.rowMasks[y]);
+		}
+		return hash ^ PieceKey(static_cast<PieceType>(snapshot.pieceType), snapshot.pieceRotation / 90, snapshot.pieceX, snapshot.pieceY) ^
+			SequenceKey(snapshot.randomizerState);
+	}
+
+	static_assert(RowKey(0u) == 0 && RowKey(7, 0u) == 0);
+	static_assert(RowKey(3, 5u) == RotateLeft(RowKey(0, 5u), 3) && RotateRight(RowKey(3, 5u), 3) == RowKey(5u));
+	static_assert(GameSnapshot::height <= maxRows);
+}
\ No newline at end of file
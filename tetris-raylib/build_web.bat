@@ -38,12 +38,25 @@ emcc -o %OUTPUT_DIR%\index.html ^
     Tetromino.cpp ^
     GameUtils.cpp ^
     raylibCpp.cpp ^
+    ParticleSystem.cpp ^
+    Gestures.cpp ^
+    MappedFile.cpp ^
+    Journal.cpp ^
+    Leaderboard.cpp ^
+    Simulation.cpp ^
+    Pieces.cpp ^
+    Replay.cpp ^
+    AllocationTracker.cpp ^
+    PathPlanner.cpp ^
+    LatencyTracker.cpp ^
+    Persistence.cpp ^
     -Os ^
     -Wall ^
     -I. ^
     -I%RAYLIB_PATH% ^
     -L%RAYLIB_PATH% ^
     -lraylib ^
+    -lidbfs.js ^
     -s USE_GLFW=3 ^
     -s ASYNCIFY ^
     -s TOTAL_MEMORY=67108864 ^
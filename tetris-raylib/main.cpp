@@ -1,8 +1,23 @@
 #include "Game.h"
 #include "Settings.h"
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+#include <array>
+#include <vector>
 
 #ifdef PLATFORM_WEB
 #include <emscripten/emscripten.h>
+#else
+#include "TrainingExport.h"
+#include "OpeningBookBuilder.h"
+#include "Perft.h"
+#include "PerfectClearSolver.h"
+#include "Equivalence.h"
+#include "FeatureCheck.h"
+#include "GameUtils.h"
 #endif
 //------------------------------------------------------------------------------------
 // Program main entry point
@@ -16,9 +31,243 @@ void UpdateDrawFrame(void)
 }
 
 
-int main(void)
+int main(int argc, char** argv)
 {
-    game = new Game(settings::screenWidth, settings::screenHeight, settings::fps, settings::title);
+    // --replay <file> opens a recording for playback
+    // --latency <file> measures input to display latency and writes the report on exit
+    // --inject <count> plays synthetic touch input in a hidden window and exits, for CI.
+    //   A debug build with TRACK_ALLOCATIONS defined is the CI check for zero steady state
+    //   allocations: it exits with 1 if any gameplay frame touched the heap.
+    // --export <file> --export-rows <count> [--export-seed <seed>] writes bot games as training data, without a window
+    // --build-book <file> searches the opening book, without a window
+    // --perft <depth> [--perft-queue <pieces, like IOTJLSZ>] counts reachable boards, without a window
+    // --perfect-clear <pieces, like IOTJLSZ> [--pc-rows <setup, like XXXX..XXXX/XXX...XXXX>] solves a perfect clear, without a window
+    // --equivalence <sequences> [--equivalence-ticks <ticks>] [--equivalence-seed <seed>] checks VecEnv, Board and Tetromino against the frozen rules, without a window
+    // --check-features <boards> [--check-features-seed <seed>] checks and times the board features, without a window
+    LaunchOptions options;
+#ifndef PLATFORM_WEB
+    std::string exportPath;
+    std::string bookPath;
+    int perftDepth = 0;
+    std::string perftQueue = "IOTJLSZIOTJLSZIO";
+    std::string perfectClearQueue;
+    std::string perfectClearRows;
+    uint64_t equivalenceSequences = 0;
+    int equivalenceTicks = 1000;
+    uint64_t equivalenceSeed = 0;
+    uint64_t featureBoards = 0;
+    uint64_t featureSeed = 0;
+    uint64_t exportRows = 1000000;
+    uint64_t exportSeed = 0;
+#endif
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--replay")
+        {
+            options.replayPath = argv[i + 1];
+        }
+        else if (arg == "--latency")
+        {
+            options.latencyReportPath = argv[i + 1];
+        }
+        else if (arg == "--inject")
+        {
+            options.injectedInputs = std::atoi(argv[i + 1]);
+        }
+#ifndef PLATFORM_WEB
+        else if (arg == "--export")
+        {
+            exportPath = argv[i + 1];
+        }
+        else if (arg == "--export-rows")
+        {
+            exportRows = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--export-seed")
+        {
+            exportSeed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--build-book")
+        {
+            bookPath = argv[i + 1];
+        }
+        else if (arg == "--perft")
+        {
+            perftDepth = std::atoi(argv[i + 1]);
+        }
+        else if (arg == "--perft-queue")
+        {
+            perftQueue = argv[i + 1];
+        }
+        else if (arg == "--perfect-clear")
+        {
+            perfectClearQueue = argv[i + 1];
+        }
+        else if (arg == "--pc-rows")
+        {
+            perfectClearRows = argv[i + 1];
+        }
+        else if (arg == "--equivalence")
+        {
+            equivalenceSequences = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--equivalence-ticks")
+        {
+            equivalenceTicks = std::atoi(argv[i + 1]);
+        }
+        else if (arg == "--equivalence-seed")
+        {
+            equivalenceSeed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--check-features")
+        {
+            featureBoards = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--check-features-seed")
+        {
+            featureSeed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+#endif
+    }
+
+#ifndef PLATFORM_WEB
+    const int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    if (perftDepth > 0)
+    {
+        std::vector<PieceType> queue;
+        if (!Perft::ParseQueue(perftQueue, queue) || perftDepth > static_cast<int>(queue.size()))
+        {
+            std::fprintf(stderr, "The queue needs at least %d pieces out of IOTJLSZ, at most %d\n", perftDepth, Perft::maxDepth);
+            return 1;
+        }
+        Perft perft;
+        perft.Run(queue.data(), perftDepth, threadCount);
+        uint64_t placements = 0;
+        std::printf("depth %14s %14s %14s\n", "placements", "boards", "topped out");
+        for (int d = 1; d <= perftDepth; ++d)
+        {
+            const Perft::DepthCount& count = perft.GetCount(d);
+            placements += count.placements;
+            std::printf("%5d %14llu %14llu %14llu\n", d, static_cast<unsigned long long>(count.placements),
+                static_cast<unsigned long long>(count.boards), static_cast<unsigned long long>(count.toppedOut));
+        }
+        std::printf("%.3f s on %d threads, %.0f placements per second\n", perft.GetSeconds(), threadCount, placements / perft.GetSeconds());
+        return 0;
+    }
+    if (!perfectClearQueue.empty())
+    {
+        constexpr int width = settings::boardWidthHeight.GetX();
+        constexpr int height = settings::boardWidthHeight.GetY();
+        std::vector<PieceType> queue;
+        std::array<uint32_t, height> rows;
+        if (!Perft::ParseQueue(perfectClearQueue, queue) || static_cast<int>(queue.size()) > PerfectClearSolver::maxPieces)
+        {
+            std::fprintf(stderr, "The queue needs 1 to %d pieces out of IOTJLSZ\n", PerfectClearSolver::maxPieces);
+            return 1;
+        }
+        if (!PerfectClearSolver::ParseRows(perfectClearRows, width, height, rows.data()))
+        {
+            std::fprintf(stderr, "The rows need %d cells each, '.' for empty, separated by '/'\n", width);
+            return 1;
+        }
+        PerfectClearSolver solver;
+        const bool isSolved = solver.Solve(rows.data(), width, height, queue.data(), static_cast<int>(queue.size()), threadCount);
+        for (int i = 0; i < solver.GetStepCount(); ++i)
+        {
+            const PerfectClearSolver::Step& step = solver.GetStep(i);
+            std::printf("%2d %c x %d y %d rotation %d\n", i + 1, "IOTJLSZ"[static_cast<int>(step.type)],
+                step.placement.x, step.placement.y, step.placement.rotation);
+        }
+        std::printf("%s, %llu nodes in %.3f s on %d threads\n", isSolved ? "Solved" : "No perfect clear",
+            static_cast<unsigned long long>(solver.GetNodeCount()), solver.GetSeconds(), threadCount);
+        return 0;
+    }
+    if (equivalenceSequences > 0 && equivalenceTicks > 0)
+    {
+        if (equivalenceSeed == 0)
+        {
+            equivalenceSeed = GenerateSeed();
+        }
+        Equivalence equivalence;
+        const bool isEquivalent = equivalence.Run(equivalenceSequences, equivalenceTicks, equivalenceSeed, threadCount);
+        const Equivalence::Totals& totals = equivalence.GetTotals();
+        std::printf("%llu sequences, %llu ticks, %llu locks, %llu lines, %llu top outs in %.3f s on %d threads, seed %llu\n",
+            static_cast<unsigned long long>(totals.sequences), static_cast<unsigned long long>(totals.ticks),
+            static_cast<unsigned long long>(totals.locks), static_cast<unsigned long long>(totals.lines),
+            static_cast<unsigned long long>(totals.topOuts), equivalence.GetSeconds(), threadCount,
+            static_cast<unsigned long long>(equivalenceSeed));
+        if (isEquivalent)
+            return 0;
+
+        // Everything needed to replay the mismatch by hand
+        const Equivalence::Mismatch& mismatch = equivalence.GetMismatch();
+        std::fprintf(stderr, "Sequence %llu differs on %s after %d ticks, %s\n", static_cast<unsigned long long>(mismatch.index),
+            mismatch.engine, mismatch.tick, mismatch.difference.c_str());
+        std::fprintf(stderr, "Minimized to randomizer state %llu\n", static_cast<unsigned long long>(mismatch.sequence.seed));
+        for (int y = 0; y < Equivalence::height; ++y)
+        {
+            if (mismatch.sequence.garbage[y] != 0)
+            {
+                std::fprintf(stderr, "garbage row %d: 0x%03x\n", y, mismatch.sequence.garbage[y]);
+            }
+        }
+        std::fprintf(stderr, "actions (%s): %s\n", Equivalence::actionLetters, Equivalence::FormatActions(mismatch.sequence.actions).c_str());
+        return 1;
+    }
+    if (featureBoards > 0)
+    {
+        if (featureSeed == 0)
+        {
+            featureSeed = GenerateSeed();
+        }
+        FeatureCheck featureCheck;
+        if (!featureCheck.Run(featureBoards, featureSeed))
+        {
+            const FeatureCheck::Mismatch& mismatch = featureCheck.GetMismatch();
+            std::fprintf(stderr, "Board %llu of %d x %d differs, %s\n", static_cast<unsigned long long>(mismatch.index),
+                mismatch.width, mismatch.height, mismatch.difference.c_str());
+            for (int y = 0; y < mismatch.height; ++y)
+            {
+                std::fprintf(stderr, "row %d: 0x%04x\n", y, mismatch.rows[y]);
+            }
+            std::fprintf(stderr, "seed %llu\n", static_cast<unsigned long long>(featureSeed));
+            return 1;
+        }
+        std::printf("%llu boards match the per cell count, %.1f ns per standard board, seed %llu\n",
+            static_cast<unsigned long long>(featureBoards), featureCheck.GetNanosecondsPerBoard(), static_cast<unsigned long long>(featureSeed));
+        return 0;
+    }
+    if (!bookPath.empty())
+    {
+        OpeningBookBuilder builder;
+        if (!builder.Build(bookPath, settings::openingBookPlies, threadCount))
+        {
+            std::fprintf(stderr, "Could not write %s\n", bookPath.c_str());
+            return 1;
+        }
+        std::printf("%llu positions in the book\n", static_cast<unsigned long long>(builder.GetEntryCount()));
+        return 0;
+    }
+    if (!exportPath.empty())
+    {
+        if (exportSeed == 0)
+        {
+            exportSeed = GenerateSeed();
+        }
+        TrainingExport trainingExport;
+        if (exportRows == 0 || !trainingExport.Run(exportPath, exportRows, exportSeed, threadCount))
+        {
+            std::fprintf(stderr, "Could not write %s\n", exportPath.c_str());
+            return 1;
+        }
+        std::printf("%llu locks from %llu games, seed %llu\n", static_cast<unsigned long long>(exportRows),
+            static_cast<unsigned long long>(trainingExport.GetGameCount()), static_cast<unsigned long long>(exportSeed));
+        return 0;
+    }
+#endif
+
+    game = new Game(settings::screenWidth, settings::screenHeight, settings::fps, settings::title, options);
 
 #ifdef PLATFORM_WEB
     emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
@@ -29,6 +278,7 @@ int main(void)
     }
 #endif
 
+    const int allocatingFrames = game->GetAllocatingFrameCount();
     delete game;
-    return 0;
+    return allocatingFrames > 0 ? 1 : 0;
 }
\ No newline at end of file